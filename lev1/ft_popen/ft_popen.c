@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/wait.h>
+#include "../proc/proc.h"
 
 /*  ft_popen(const char *file, char *const argv[], char type)
 	Implementa una versione semplificata di popen(), creando una pipe
@@ -17,61 +18,42 @@
   Flusso:
 	- Controlla che i parametri siano validi e che il tipo sia 'r' o 'w';
 	  altrimenti ritorna -1.
-	- Crea una pipe (fd[0] per lettura, fd[1] per scrittura).
+	- Crea una pipe O_CLOEXEC con proc_pipe (fd[0] per lettura, fd[1]
+	  per scrittura): nessun figlio lanciato dopo la eredita.
 	- In caso di errore nella creazione della pipe, ritorna -1.
-	- Esegue fork() per creare un processo figlio.
-	  * Se fork fallisce, chiude entrambi i file descriptors e ritorna -1.
-	- Nel processo figlio:
-		* Se type == 'r':
-			chiude fd[0] (lettura),
-			duplica fd[1] su STDOUT,
-			chiude fd[1].
-		* Se type == 'w':
-			chiude fd[1] (scrittura),
-			duplica fd[0] su STDIN,
-			chiude fd[0].
-		* Esegue il comando con execvp(file, argv).
-		* Se execvp fallisce, termina con exit(1).
+	- Lancia il comando con proc_spawn (posix_spawnp) invece di
+	  fork() + execvp(): niente copia delle tabelle delle pagine del
+	  padre, il costo del lancio non dipende dalla sua memoria.
+		* Se type == 'r': lo stdout del figlio diventa fd[1].
+		* Se type == 'w': lo stdin del figlio diventa fd[0].
+		* L'altro lato si chiude da solo all'exec (O_CLOEXEC).
+	  * Se il lancio fallisce (anche per comando inesistente), chiude
+	    entrambi i file descriptors e ritorna -1.
 	- Nel processo padre:
 		* Se type == 'r':
 			chiude fd[1] e ritorna fd[0] per leggere l’output del figlio.
 		* Se type == 'w':
 			chiude fd[0] e ritorna fd[1] per scrivere sull’input del figlio.
 	- Il descrittore restituito può essere usato per comunicare con il
-	  processo figlio attraverso la pipe.
+	  processo figlio attraverso la pipe. Il pid non viene restituito:
+	  per attendere il figlio per pid c'è ft_popen_async.
 */
 int	ft_popen(const char *file, char *const argv[], char type)
 {
 	if(!file || !argv || (type != 'r' && type != 'w')) return (-1);
 	int	fd[2];
-	if(pipe(fd) == -1) return (-1);
-	pid_t	pid = fork();
-	if(pid == -1) {
+	if(proc_pipe(fd, 0) == -1) return (-1);
+	t_proc	p;
+	int		child = type == 'r' ? 1 : 0;
+	int		io[3] = {-1, -1, -1};
+	io[child] = fd[child];
+	if(proc_spawn(&p, file, argv, io) == -1) {
 		close(fd[0]);
 		close(fd[1]);
 		return -1;
 	}
-	if(pid == 0) {
-		if(type == 'r')
-		{
-			close(fd[0]);
-			dup2(fd[1], 1);
-			close(fd[1]);
-		} else {
-			close(fd[1]);
-			dup2(fd[0], 0);
-			close(fd[0]);
-		}
-		execvp(file, argv);
-		exit(1);
-	}
-	if(type == 'r') {
-		close(fd[1]);
-		return fd[0];
-	} else {
-		close(fd[0]);
-		return fd[1];
-	}
+	close(fd[child]);
+	return fd[1 - child];
 }
 
 // int main(void)
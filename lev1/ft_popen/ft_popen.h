@@ -0,0 +1,57 @@
+#ifndef FT_POPEN_H
+#define FT_POPEN_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "../proc/proc.h"
+
+/*
+** Handle di ft_popen_async:
+**   - proc: il figlio (pid, pidfd, stato e misure, vedi proc/proc.h);
+**     il pidfd diventa leggibile quando il figlio termina (-1 se il
+**     kernel non supporta pidfd_open)
+**   - fd: lato della pipe del padre, O_CLOEXEC | O_NONBLOCK
+**   - type: 'r' o 'w' come in ft_popen, 'b' per ft_popen_rw
+**   - wfd: con 'b', lato di scrittura verso lo stdin del figlio
+**     (fd legge il suo stdout); altrimenti -1
+**   - out/len/cap: uscita raccolta da ft_popen_collect
+*/
+typedef struct s_popen {
+	t_proc	proc;
+	int		fd;
+	char	type;
+	int		wfd;
+	char	*out;
+	size_t	len;
+	size_t	cap;
+}	t_popen;
+
+/*
+** Zygote: processo piccolo creato con zygote_start all'avvio, che
+** lancia i figli al posto del chiamante. proc è il zygote stesso
+** (creato con proc_fork, raccolto da zygote_stop), sock è il socket
+** Unix verso di lui, lock serializza richiesta e risposta tra thread.
+*/
+typedef struct s_zygote {
+	t_proc			proc;
+	int				sock;
+	pthread_mutex_t	lock;
+}	t_zygote;
+
+int	ft_popen(const char *file, char *const argv[], char type);
+int	ft_popen_async(t_popen *p, const char *file, char *const argv[],
+		char type);
+int	ft_popen_collect(t_popen *ps, size_t n);
+int	ft_pclose_async(t_popen *p);
+int	ft_popen_rw(t_popen *p, const char *file, char *const argv[]);
+int	ft_popen_pump(t_popen *p, const char *in, size_t len);
+int	zygote_start(t_zygote *z);
+int	ft_popen_zygote(t_zygote *z, const char *file, char *const argv[],
+		char type, pid_t *pid);
+void	zygote_stop(t_zygote *z);
+
+/*UTILS*/
+int	ft_popen_drain(t_popen *p);
+
+#endif
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <stdio.h>
+#include "../proc/proc.h"
 
 /*
 **   - fd[2]: pipe creata [0]=lettura, [1]=scrittura
@@ -21,28 +22,25 @@
 **   - argv: array di argomenti per il comando (terminato con NULL)
 **   - type: 'r' per lettura (comando scrive), 'w' per scrittura (comando legge)
   - type == 'r' (Read mode):
-**      * Reindirizza stdout del figlio su fd[1] (scrittura della pipe)
+**      * Lo stdout del figlio diventa fd[1] (scrittura della pipe)
 **      * Il padre leggerà da fd[0] l'output del comando
   - type == 'w' (Write mode):
-**      * Reindirizza stdin del figlio da fd[0] (lettura della pipe)
+**      * Lo stdin del figlio diventa fd[0] (lettura della pipe)
 **      * Il padre scriverà su fd[1] che il figlio leggerà dallo stdin
+** Il figlio lo lancia proc_spawn (posix_spawnp); la pipe è O_CLOEXEC,
+** quindi nel figlio non serve chiudere niente a mano.
+** Ritorno: 0, -1 se il lancio fallisce
 */
-void	handleChild(int fd[2], const char *file, char *const argv[], char type)
+int	handleChild(int fd[2], const char *file, char *const argv[], char type)
 {
+	t_proc	p;
+	int		io[3] = {-1, -1, -1};
+
 	if (type == 'r')
-	{
-		if(dup2(fd[1], STDOUT_FILENO) == -1)
-			exit(1);
-	}
+		io[STDOUT_FILENO] = fd[1];
 	else
-	{
-		if(dup2(fd[0], STDIN_FILENO) == -1)
-			exit(1);
-	}
-	close(fd[0]);
-	close(fd[1]);
-	execvp(file, argv);
-	exit(1);
+		io[STDIN_FILENO] = fd[0];
+	return (proc_spawn(&p, file, argv, io));
 }
 
 /*
@@ -86,29 +84,25 @@ int	handleParent(int fd[2], char type)
 **   3. Controlla che argv[0] non sia NULL
 **   4. Controlla che type sia 'r' o 'w'
 
-**   1. Crea una pipe con pipe()
-**   2. Crea un processo figlio con fork()
-**   3. Nel figlio: chiama handleChild() per eseguire il comando
-**   4. Nel padre: chiama handleParent() per ritornare il file descriptor corretto
+**   1. Crea una pipe O_CLOEXEC con proc_pipe()
+**   2. Lancia il comando con handleChild() (niente fork(): posix_spawnp)
+**   3. Se il lancio fallisce chiude la pipe e ritorna -1
+**   4. Chiama handleParent() per ritornare il file descriptor corretto
 */
 int	ft_popen(const char *file, char *const argv[], char type)
 {
 	int		fd[2];
-	pid_t	pid;
 
 	if(!file || !argv || !argv[0] || (type != 'r' && type != 'w'))
 		return (-1);
-	if(pipe(fd) == -1)
+	if(proc_pipe(fd, 0) == -1)
 		return (-1);
-	pid = fork();
-	if (pid == -1)
+	if (handleChild(fd, file, argv, type) == -1)
 	{
 		close(fd[0]);
 		close(fd[1]);
 		return (-1);
 	}
-	if (pid == 0)
-		handleChild(fd, file, argv, type);
 	return (handleParent(fd, type));
 }
 
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include "ft_popen.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+/*
+** ft_popen asincrono: invece di un fd nudo ritorna un handle con il pid
+** del figlio, così chi chiama lo raccoglie lui (wait(NULL) nei test di
+** ft_popen può raccogliere il figlio sbagliato).
+**   - il lato del padre è O_NONBLOCK: una read senza dati ritorna EAGAIN
+**     invece di fermare tutto su un figlio lento. Il flag si mette solo
+**     sul lato del padre: i due lati di una pipe sono descrizioni di file
+**     distinte e il figlio deve leggere/scrivere in modo bloccante
+**   - tutto è O_CLOEXEC: i figli lanciati dopo non ereditano le pipe
+**     degli altri (un lato di scrittura ereditato toglierebbe l'EOF)
+**   - lancio, pidfd e attesa sono quelli di proc/proc.c
+**   - il pidfd segnala la fine del figlio dentro lo stesso epoll dei
+**     dati, senza SIGCHLD
+** ft_popen_collect guida molti figli 'r' insieme: un solo epoll_wait
+** per tutti i fd e i pidfd, ogni fd svuotato finché dà EAGAIN.
+*/
+int	ft_popen_async(t_popen *p, const char *file, char *const argv[],
+		char type)
+{
+	int	fd[2];
+	int	io[3] = {-1, -1, -1};
+	int	child = type == 'r';
+
+	*p = (t_popen){.fd = -1, .wfd = -1, .type = type,
+		.proc = {.pid = -1, .pidfd = -1}};
+	if (!file || !argv || (type != 'r' && type != 'w'))
+		return (-1);
+	if (proc_pipe(fd, 0) == -1)
+		return (-1);
+	io[child] = fd[child];
+	if (proc_spawn(&p->proc, file, argv, io) == -1)
+		return (close(fd[0]), close(fd[1]), -1);
+	close(fd[child]);
+	p->fd = fd[1 - child];
+	fcntl(p->fd, F_SETFL, fcntl(p->fd, F_GETFL) | O_NONBLOCK);
+	proc_pidfd(&p->proc);
+	return (0);
+}
+
+/*
+** Legge da p->fd finché non dà EAGAIN, accodando a p->out.
+** Ritorna 1 a fine file, 0 se mancano dati, -1 se fallisce
+** un'allocazione o la read. Il fd lo chiude il chiamante.
+*/
+int	ft_popen_drain(t_popen *p)
+{
+	ssize_t	n;
+
+	while (1)
+	{
+		if (p->len == p->cap)
+		{
+			size_t	cap = p->cap ? p->cap * 2 : 4096;
+			char	*tmp = realloc(p->out, cap);
+
+			if (!tmp)
+				return (-1);
+			p->out = tmp;
+			p->cap = cap;
+		}
+		n = read(p->fd, p->out + p->len, p->cap - p->len);
+		if (n > 0)
+			p->len += n;
+		else if (n == -1 && errno == EINTR)
+			continue ;
+		else if (n == -1 && errno == EAGAIN)
+			return (0);
+		else
+			return (n == 0 ? 1 : -1);
+	}
+}
+
+static int	watch(int ep, int fd, uint64_t tag)
+{
+	struct epoll_event	ev = {.events = EPOLLIN, .data.u64 = tag};
+
+	return (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev));
+}
+
+/*
+** Un evento: tag pari = dati sul fd del figlio tag/2, dispari = il suo
+** pidfd. Ritorna quante sorgenti si sono chiuse (0 o 1), -1 su errore.
+*/
+static int	on_event(int ep, t_popen *p, uint64_t tag)
+{
+	int	r;
+
+	if (tag & 1)
+	{
+		proc_wait(&p->proc, WNOHANG);
+		return (p->proc.reaped);
+	}
+	r = ft_popen_drain(p);
+	if (r == 0)
+		return (0);
+	epoll_ctl(ep, EPOLL_CTL_DEL, p->fd, NULL);
+	close(p->fd);
+	p->fd = -1;
+	return (r);
+}
+
+/*
+** ft_popen_collect: legge fino a EOF l'uscita di tutti gli handle 'r'
+** (in ps[i].out, ps[i].len) e raccoglie tutti i figli. Gli handle 'w'
+** vengono solo raccolti: il loro fd va chiuso prima, o il figlio resta
+** in attesa dell'EOF. Ritorna 0, oppure -1 se qualcosa fallisce (i
+** figli vengono raccolti comunque).
+*/
+int	ft_popen_collect(t_popen *ps, size_t n)
+{
+	struct epoll_event	ev[64];
+	int					ep = epoll_create1(EPOLL_CLOEXEC);
+	size_t				active = 0;
+	int					ret = ep == -1 ? -1 : 0;
+
+	for (size_t i = 0; ep != -1 && i < n; i++)
+	{
+		if (ps[i].type == 'r' && ps[i].fd != -1 && !watch(ep, ps[i].fd, 2 * i))
+			active++;
+		if (!ps[i].proc.reaped && ps[i].proc.pidfd != -1
+			&& !watch(ep, ps[i].proc.pidfd, 2 * i + 1))
+			active++;
+	}
+	while (active > 0)
+	{
+		int	k = epoll_wait(ep, ev, 64, -1);
+
+		if (k == -1 && errno == EINTR)
+			continue ;
+		if (k == -1)
+		{
+			ret = -1;
+			break ;
+		}
+		for (int e = 0; e < k; e++)
+		{
+			int	r = on_event(ep, &ps[ev[e].data.u64 / 2], ev[e].data.u64);
+
+			ret = r < 0 ? -1 : ret;
+			active -= r != 0;
+		}
+	}
+	for (size_t i = 0; i < n; i++)
+		proc_wait(&ps[i].proc, 0);
+	if (ep != -1)
+		close(ep);
+	return (ret);
+}
+
+/*
+** Chiude i fd (se ancora aperti) e attende il figlio.
+** Ritorna lo stato di wait4 (le misure restano in p->proc), -1 se non
+** è stato possibile. p->out resta al chiamante (free).
+*/
+int	ft_pclose_async(t_popen *p)
+{
+	if (p->fd != -1)
+		close(p->fd);
+	if (p->wfd != -1)
+		close(p->wfd);
+	p->fd = -1;
+	p->wfd = -1;
+	proc_wait(&p->proc, 0);
+	return (p->proc.status);
+}
+
+// int	main(void)
+// {
+// 	t_popen	ps[100];
+// 	char	arg[100][16];
+
+// 	for (int i = 0; i < 100; i++)
+// 	{
+// 		snprintf(arg[i], sizeof(arg[i]), "%d", i);
+// 		ft_popen_async(&ps[i], "sh",
+// 			(char *const []){"sh", "-c", "sleep 0.1; seq $0", arg[i], NULL}, 'r');
+// 	}
+// 	ft_popen_collect(ps, 100);						// ~0.1s, non 10s
+// 	for (int i = 0; i < 100; i++)
+// 	{
+// 		printf("%d: %zu bytes, status %d\n", i, ps[i].len,
+// 			WEXITSTATUS(ps[i].proc.status));
+// 		ft_pclose_async(&ps[i]);
+// 		free(ps[i].out);
+// 	}
+// 	return (0);
+// }
@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include "ft_popen.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+/*
+** Zygote: anche con posix_spawn il costo di un lancio cresce con la
+** memoria del processo che lancia. zygote_start crea una volta sola,
+** all'avvio, un processo aiutante ancora piccolo; poi ogni
+** ft_popen_zygote gli chiede di lanciare il comando e riceve indietro
+** il lato della pipe, passato con SCM_RIGHTS sul socket.
+**
+** Protocollo (socketpair SOCK_SEQPACKET, un messaggio per richiesta):
+**   richiesta: type, file, argv[0], ..., argv[n-1], ogni stringa
+**              terminata da '\0'
+**   risposta:  { int32 pid, int32 errno } + il fd come messaggio
+**              ancillare (solo se errno == 0)
+**
+** I figli sono figli del zygote, che li raccoglie da solo (SIGCHLD
+** ignorato): il chiamante non può attenderli, vede solo l'EOF sulla
+** pipe. Nei figli SIGCHLD torna al default (lo fa proc_spawn),
+** altrimenti una shell lanciata così non potrebbe attendere i suoi
+** processi.
+** Il zygote termina quando il chiamante chiude il socket.
+*/
+#define ZYG_MAX_MSG (64 * 1024)
+#define ZYG_MAX_ARGS 1024
+
+typedef struct s_reply {
+	int32_t	pid;
+	int32_t	err;
+}	t_reply;
+
+/*
+** ZYGOTE
+*/
+static int	zyg_spawn(char type, const char *file, char **argv, int *fd,
+		pid_t *pid)
+{
+	t_proc	p;
+	int		io[3] = {-1, -1, -1};
+	int		fds[2];
+	int		child = type == 'r';
+	int		err = 0;
+
+	if (proc_pipe(fds, 0) == -1)
+		return (errno);
+	io[child] = fds[child];
+	if (proc_spawn(&p, file, argv, io) == -1)
+		err = errno;
+	close(fds[child]);
+	if (err)
+		close(fds[1 - child]);
+	*fd = err ? -1 : fds[1 - child];
+	*pid = p.pid;
+	return (err);
+}
+
+static void	zyg_reply(int sock, pid_t pid, int err, int fd)
+{
+	t_reply			r = {.pid = pid, .err = err};
+	struct iovec	iov = {.iov_base = &r, .iov_len = sizeof(r)};
+	char			cbuf[CMSG_SPACE(sizeof(int))] = {0};
+	struct msghdr	msg = {.msg_iov = &iov, .msg_iovlen = 1};
+	struct cmsghdr	*c;
+
+	if (fd != -1)
+	{
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		c = CMSG_FIRSTHDR(&msg);
+		c->cmsg_level = SOL_SOCKET;
+		c->cmsg_type = SCM_RIGHTS;
+		c->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(c), &fd, sizeof(int));
+	}
+	while (sendmsg(sock, &msg, MSG_NOSIGNAL) == -1 && errno == EINTR)
+		;
+}
+
+/*
+** Divide la richiesta in type, file e argv (terminato da NULL).
+** Ritorna 0 o un codice errno.
+*/
+static int	zyg_parse(char *buf, size_t n, char **file, char **argv)
+{
+	size_t	i = 1;
+	int		argc = -1;
+
+	if (n < 2 || buf[n - 1] != '\0' || (buf[0] != 'r' && buf[0] != 'w'))
+		return (EINVAL);
+	while (i < n && argc < ZYG_MAX_ARGS - 1)
+	{
+		if (argc == -1)
+			*file = buf + i;
+		else
+			argv[argc] = buf + i;
+		argc++;
+		i += strlen(buf + i) + 1;
+	}
+	if (i < n || argc < 1)
+		return (argc < 1 ? EINVAL : E2BIG);
+	argv[argc] = NULL;
+	return (0);
+}
+
+static void	zyg_loop(int sock)
+{
+	static char		buf[ZYG_MAX_MSG];
+	static char		*argv[ZYG_MAX_ARGS];
+	char			*file;
+	ssize_t			n;
+	pid_t			pid;
+	int				fd;
+	int				err;
+
+	while (1)
+	{
+		n = recv(sock, buf, sizeof(buf), MSG_TRUNC);
+		if (n == -1 && errno == EINTR)
+			continue ;
+		if (n <= 0)
+			break ;
+		pid = -1;
+		fd = -1;
+		err = n > (ssize_t)sizeof(buf) ? E2BIG
+			: zyg_parse(buf, n, &file, argv);
+		if (!err)
+			err = zyg_spawn(buf[0], file, argv, &fd, &pid);
+		zyg_reply(sock, pid, err, fd);
+		if (fd != -1)
+			close(fd);
+	}
+	_exit(0);
+}
+
+/*
+** zygote_start: da chiamare presto, quando il processo è ancora
+** piccolo (è l'unico fork dell'intero schema). Il zygote chiude tutti
+** i fd tranne stdin/stdout/stderr e il suo socket.
+** I figli ereditano dal zygote, non dal chiamante: ambiente (PATH
+** compreso), directory corrente, umask e stdin/stdout/stderr sono
+** quelli del momento di zygote_start. Un setenv o chdir successivo del
+** chiamante non arriva ai comandi lanciati con ft_popen_zygote.
+** Ritorna 0, -1 in caso di errore.
+*/
+int	zygote_start(t_zygote *z)
+{
+	int	sv[2];
+
+	z->proc = (t_proc){.pid = -1, .pidfd = -1};
+	z->sock = -1;
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+		return (-1);
+	if (proc_fork(&z->proc, NULL) == 0)
+	{
+		signal(SIGCHLD, SIG_IGN);
+		if (sv[1] > 3)
+			syscall(SYS_close_range, 3, sv[1] - 1, 0);
+		syscall(SYS_close_range, sv[1] + 1, ~0U, 0);
+		zyg_loop(sv[1]);
+	}
+	if (z->proc.pid == -1)
+		return (close(sv[0]), close(sv[1]), -1);
+	close(sv[1]);
+	z->sock = sv[0];
+	pthread_mutex_init(&z->lock, NULL);
+	return (0);
+}
+
+/*
+** CLIENT
+*/
+static ssize_t	pack(char *buf, char type, const char *file,
+		char *const argv[])
+{
+	size_t	n = 1;
+
+	buf[0] = type;
+	for (int i = -1; i == -1 || argv[i]; i++)
+	{
+		const char	*s = i == -1 ? file : argv[i];
+		size_t		len = strlen(s) + 1;
+
+		if (n + len > ZYG_MAX_MSG)
+			return (-1);
+		memcpy(buf + n, s, len);
+		n += len;
+	}
+	return (n);
+}
+
+static int	recv_fd(int sock, t_reply *r)
+{
+	struct iovec	iov = {.iov_base = r, .iov_len = sizeof(*r)};
+	char			cbuf[CMSG_SPACE(sizeof(int))];
+	struct msghdr	msg = {.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = cbuf, .msg_controllen = sizeof(cbuf)};
+	struct cmsghdr	*c;
+	int				fd = -1;
+	ssize_t			n;
+
+	do
+		n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	while (n == -1 && errno == EINTR);
+	if (n != sizeof(*r))
+		return (r->err = n == -1 ? errno : EPIPE, -1);
+	c = CMSG_FIRSTHDR(&msg);
+	if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS)
+		memcpy(&fd, CMSG_DATA(c), sizeof(int));
+	return (fd);
+}
+
+/*
+** ft_popen_zygote: come ft_popen, ma il figlio lo lancia il zygote
+** (con ambiente e directory di zygote_start, vedi sopra).
+** Ritorna il fd (O_CLOEXEC) e, se pid non è NULL, il pid del figlio;
+** -1 con errno impostato in caso di errore.
+*/
+int	ft_popen_zygote(t_zygote *z, const char *file, char *const argv[],
+		char type, pid_t *pid)
+{
+	char	*buf;
+	ssize_t	n;
+	t_reply	r = {.pid = -1};
+	int		fd = -1;
+
+	if (!file || !argv || (type != 'r' && type != 'w') || z->sock == -1)
+		return (errno = EINVAL, -1);
+	buf = malloc(ZYG_MAX_MSG);
+	if (!buf)
+		return (-1);
+	n = pack(buf, type, file, argv);
+	if (n == -1)
+		r.err = E2BIG;
+	pthread_mutex_lock(&z->lock);
+	if (n != -1 && send(z->sock, buf, n, MSG_NOSIGNAL) == -1)
+		r.err = errno;
+	else if (n != -1)
+		fd = recv_fd(z->sock, &r);
+	pthread_mutex_unlock(&z->lock);
+	free(buf);
+	if (pid)
+		*pid = r.pid;
+	if (fd == -1)
+		errno = r.err ? r.err : EPROTO;
+	return (fd);
+}
+
+void	zygote_stop(t_zygote *z)
+{
+	if (z->sock == -1)
+		return ;
+	close(z->sock);
+	proc_wait(&z->proc, 0);
+	pthread_mutex_destroy(&z->lock);
+	z->sock = -1;
+}
+
+// int	main(void)
+// {
+// 	t_zygote	z;
+// 	char		buffer[1024];
+// 	ssize_t		n;
+// 	int			fd;
+
+// 	zygote_start(&z);								// prima di crescere
+// 	for (int i = 0; i < 3; i++)
+// 	{
+// 		fd = ft_popen_zygote(&z, "echo",
+// 			(char *const []){"echo", "hello from the zygote", NULL}, 'r', NULL);
+// 		while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+// 			write(1, buffer, n);
+// 		close(fd);
+// 	}
+// 	fd = ft_popen_zygote(&z, "nonexistent", (char *const []){"x", NULL},
+// 		'r', NULL);
+// 	printf("fd %d: %s\n", fd, strerror(errno));		// -1: No such file...
+// 	zygote_stop(&z);
+// 	return (0);
+// }
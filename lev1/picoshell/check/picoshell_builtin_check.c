@@ -0,0 +1,139 @@
+/*
+** picoshell_builtin_check: confronta gli stadi interni di
+** picoshell_builtin con i comandi esterni lanciati da picoshell.
+**
+** Compilazione:
+**   cc -O2 -pthread -I.. picoshell_builtin_check.c ../picoshell.c \
+**       ../picoshell_builtin.c ../../proc/proc.c -o picoshell_builtin_check
+**
+** Uso:
+**   ./picoshell_builtin_check
+**
+** Per ogni caso si esegue "cat input | comando" due volte, con
+** picoshell_builtin e con picoshell, e si confrontano byte per byte le
+** due uscite. L'ingresso binario contiene tutti i 256 byte (NUL
+** compreso) e un po' di testo, quello di testo solo il testo. Ogni
+** caso dice anche se il comando deve girare come interno (escape che
+** l'interno sa leggere) o ricadere sull'esterno (escape sconosciuti,
+** grep con più pattern): anche questo viene controllato con
+** picoshell_is_builtin. Su ingresso binario grep scrive "binary file
+** matches" su stderr, che non viene confrontato.
+** Stampa una riga per caso ed esce con 1 se almeno un caso fallisce.
+*/
+#define _GNU_SOURCE
+#include "picoshell.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#define MAX_OUT (1 << 20)
+
+typedef struct s_case {
+	char	*argv[5];
+	int		builtin;
+	int		text;
+}	t_case;
+
+static const t_case	g_cases[] = {
+	{{"tr", "-d", "\\0", NULL}, 1, 0},
+	{{"tr", "\\a", "x", NULL}, 1, 0},
+	{{"tr", "\\101\\102", "xy", NULL}, 1, 0},
+	{{"tr", "-d", "\\000-\\037", NULL}, 1, 0},
+	{{"tr", "\\141-\\143", "X", NULL}, 1, 0},
+	{{"tr", "a-\\143", "\\t\\n\\v", NULL}, 1, 0},
+	{{"tr", "\\\\", "/", NULL}, 1, 0},
+	{{"tr", "-d", "\\b\\f\\r", NULL}, 1, 0},
+	{{"tr", "\\400", "xy", NULL}, 1, 0},
+	{{"tr", "\\377\\376", "\\001", NULL}, 1, 0},
+	{{"tr", "\\q", "x", NULL}, 0, 0},
+	{{"tr", "\\e", "x", NULL}, 0, 0},
+	{{"tr", "a\\", "x", NULL}, 0, 0},
+	{{"grep", "a", NULL}, 1, 0},
+	{{"grep", "-c", "a", NULL}, 1, 0},
+	{{"grep", "-v", "zzz", NULL}, 1, 0},
+	{{"grep", "zzz", NULL}, 1, 0},
+	{{"grep", "a", NULL}, 1, 1},
+	{{"grep", "-vc", "abc", NULL}, 1, 1},
+	{{"grep", "-F", "abc\nend", NULL}, 0, 1},
+	{{"grep", "q\n0", NULL}, 0, 1},
+};
+
+/*
+** Esegue cat path | argv con run (picoshell o picoshell_builtin) e
+** legge lo stdout in out. Ritorna i byte letti, -1 in caso di errore.
+*/
+static ssize_t	capture(int (*run)(char **[]), char *path, char **argv,
+		char *out)
+{
+	char	*cat[] = {"cat", path, NULL};
+	char	**cmds[] = {cat, argv, NULL};
+	char	tmp[] = "/tmp/pbcheckXXXXXX";
+	int		fd = mkstemp(tmp);
+	int		saved = dup(STDOUT_FILENO);
+	ssize_t	n = -1;
+
+	if (fd == -1 || saved == -1)
+		return (-1);
+	unlink(tmp);
+	fflush(stdout);
+	dup2(fd, STDOUT_FILENO);
+	run(cmds);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	if (lseek(fd, 0, SEEK_SET) == 0)
+		n = read(fd, out, MAX_OUT);
+	close(fd);
+	return (n);
+}
+
+static int	write_input(char *path, int text_only)
+{
+	const char	text[] = "abc ABC \\ q 0123\n\ttab\a\b\f\v\r end\n";
+	int			fd = mkstemp(path);
+	char		all[256];
+
+	if (fd == -1)
+		return (-1);
+	for (int i = 0; i < 256; i++)
+		all[i] = (char)i;
+	if ((!text_only && write(fd, all, sizeof(all)) != sizeof(all))
+		|| write(fd, text, sizeof(text) - 1) != sizeof(text) - 1)
+		return (close(fd), -1);
+	return (close(fd));
+}
+
+int	main(void)
+{
+	char	path[2][19] = {"/tmp/pbinputXXXXXX", "/tmp/pbinputXXXXXX"};
+	char	*a = malloc(MAX_OUT);
+	char	*b = malloc(MAX_OUT);
+	int		ret = 0;
+
+	if (!a || !b || write_input(path[0], 0) == -1
+		|| write_input(path[1], 1) == -1)
+		return (perror("picoshell_builtin_check"), 1);
+	for (size_t i = 0; i < sizeof(g_cases) / sizeof(*g_cases); i++)
+	{
+		char	**argv = (char **)g_cases[i].argv;
+		char	*in = path[g_cases[i].text];
+		int		is_bi = picoshell_is_builtin(argv);
+		ssize_t	na = capture(picoshell_builtin, in, argv, a);
+		ssize_t	nb = capture(picoshell, in, argv, b);
+		int		ok = na >= 0 && na == nb && !memcmp(a, b, na)
+			&& is_bi == g_cases[i].builtin;
+
+		printf("%-4s %-8s %s ", ok ? "ok" : "FAIL",
+			is_bi ? "builtin" : "external", g_cases[i].text ? "text" : "bin ");
+		for (int k = 0; argv[k]; k++)
+			printf(" '%s'", argv[k]);
+		printf("\n");
+		ret |= !ok;
+	}
+	unlink(path[0]);
+	unlink(path[1]);
+	free(a);
+	free(b);
+	return (ret);
+}
@@ -2,81 +2,127 @@
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <stdio.h>
+#include "picoshell.h"
+#include "../proc/proc.h"
+
 /*
   Variabili:
-	- pid: pid del processo figlio
+	- ps: un t_proc per comando (pid, stato, misure)
 	- fd[2]: file descriptors per la pipe
 	- prev_fd: file descriptor per l'input del comando corrente
-	- status: stato di terminazione del processo figlio
 	- exit_code: codice di uscita complessivo
 	- i: indice del comando corrente
+  Lancio dei figli (proc/proc.c):
+	Niente fork() + execvp(): fork copia le tabelle delle pagine del
+	padre e con un padre grande ogni lancio costa millisecondi.
+	proc_spawn usa posix_spawnp (in glibc clone con CLONE_VM|CLONE_VFORK),
+	che condivide la memoria del padre fino all'exec. Le pipe di
+	proc_pipe sono O_CLOEXEC, quindi al figlio bastano i dup2 su
+	stdin/stdout: ogni altro fd di pipe si chiude da solo all'exec.
   Flusso:
 	- Crea la pipe se non è l'ultimo comando.
-	- Errore pipe: se accade, chiude prev_fd (se valido) e ritorna 1.
-	- Crea un nuovo processo con fork.
-	- Errore fork:
-		se la pipe esiste, chiude fd[0] e fd[1]; chiude prev_fd (se valido)
-		e ritorna 1.
-	- Processo figlio:
-		* Se non è il primo comando, duplica prev_fd su STDIN; poi chiude
-		  prev_fd.
-		* Se non è l'ultimo comando, chiude il lato di lettura della pipe,
-		  duplica fd[1] su STDOUT e chiude fd[1].
-		* Esegue il comando con execvp; se fallisce, termina con exit(1).
+	- Errore pipe: se accade, chiude prev_fd (se valido), attende i
+	  figli già lanciati e ritorna 1.
+	- Lancia il comando con stdin = prev_fd (se non è il primo) e
+	  stdout = fd[1] (se non è l'ultimo).
+	- Errore di lancio (comando inesistente o risorse esaurite): vale
+	  come un figlio uscito con errore, exit_code = 1, e la pipeline
+	  prosegue (il comando successivo riceve EOF).
 	- Processo padre:
 		* Chiude l'fd di input del comando precedente, se presente.
 		* Se non è l'ultimo comando, chiude il lato di scrittura della
 		  pipe e salva fd[0] in prev_fd per il prossimo comando.
-	- Attende la terminazione di tutti i processi figli; se uno termina
-	  con errore (WIFEXITED e WEXITSTATUS != 0), imposta exit_code a 1.
+	- Attende i propri figli per pid (non wait(): gli altri figli del
+	  chiamante restano suoi); se uno termina con errore (WIFEXITED e
+	  WEXITSTATUS != 0), imposta exit_code a 1.
 	- Ritorna exit_code come codice di uscita complessivo.
 */
-int	picoshell(char **cmds[])
+static int	run_pipeline(char **cmds[], t_proc *ps, int n)
 {
-	pid_t	pid;
 	int		fd[2];
 	int		prev_fd = -1;
-	int		status;
 	int		exit_code = 0;
-	int		i = 0;
-	while (cmds[i])
+
+	for (int i = 0; i < n; i++)
 	{
-		if (cmds[i + 1] && (pipe(fd) == -1)) {
-			if (prev_fd != -1) close(prev_fd);
-			return (1);
-		}
-		pid = fork();
-		if (pid == -1) {
-			if (cmds[i + 1]) {
-				close(fd[0]);
-				close(fd[1]);
-			}
-			if (prev_fd != -1) close(prev_fd);
-			return (1);
-		}
-		if (pid == 0) {
-			if (prev_fd != -1) {
-				if (dup2(prev_fd, STDIN_FILENO) == -1) exit(1);
-				close(prev_fd);
-			}
-			if (cmds[i + 1]) {
-				close(fd[0]);
-				if (dup2(fd[1], STDOUT_FILENO) == -1) exit(1);
-				close(fd[1]);
-			}
-			execvp(cmds[i][0], cmds[i]);
-			exit(1);
+		if (cmds[i + 1] && proc_pipe(fd, 0) == -1) {
+			exit_code = 1;
+			break ;
 		}
+		if (proc_spawn(&ps[i], cmds[i][0], cmds[i],
+				(int [3]){prev_fd, cmds[i + 1] ? fd[1] : -1, -1}) == -1)
+			exit_code = 1;
 		if (prev_fd != -1) close(prev_fd);
+		prev_fd = -1;
 		if (cmds[i + 1]) {
 			close(fd[1]);
 			prev_fd = fd[0];
 		}
-		i++;
 	}
-	while (wait(&status) != -1){
-		if (WIFEXITED(status) && WEXITSTATUS(status) != 0) exit_code = 1;
+	if (prev_fd != -1) close(prev_fd);
+	proc_wait_all(ps, n);
+	return (exit_code);
+}
+
+static int	count_cmds(char **cmds[])
+{
+	int	n = 0;
+
+	while (cmds[n])
+		n++;
+	return (n);
+}
+
+int	picoshell(char **cmds[])
+{
+	int		n = count_cmds(cmds);
+	t_proc	*ps = malloc((n ? n : 1) * sizeof(*ps));
+	int		exit_code;
+
+	if (!ps) return (1);
+	for (int i = 0; i < n; i++)
+		ps[i] = (t_proc){.pid = -1, .pidfd = -1};
+	exit_code = run_pipeline(cmds, ps, n);
+	for (int i = 0; i < n; i++)
+		if (ps[i].pid > 0 && WIFEXITED(ps[i].status) && WEXITSTATUS(ps[i].status) != 0)
+			exit_code = 1;
+	free(ps);
+	return (exit_code);
+}
+
+/*
+** picoshell_stats: come picoshell(), e riempie st[i] (st ha un elemento
+** per comando) con stato di uscita, tempo reale, CPU utente/sistema e
+** picco di memoria.
+**
+** Il tempo reale va dal lancio al momento in cui lo stadio termina, non
+** a quando lo si attende: proc_wait_all raccoglie ogni stadio appena
+** il suo pidfd diventa leggibile, così un "head" che esce prima di chi
+** lo precede non eredita il tempo degli altri. Se pidfd_open non c'è
+** (kernel < 5.3) si attende in ordine e il tempo include l'attesa.
+*/
+int	picoshell_stats(char **cmds[], t_stage_stat *st)
+{
+	int		n = count_cmds(cmds);
+	t_proc	*ps = malloc((n ? n : 1) * sizeof(*ps));
+	int		exit_code;
+
+	if (!ps) return (1);
+	for (int i = 0; i < n; i++)
+		ps[i] = (t_proc){.pid = -1, .pidfd = -1};
+	exit_code = run_pipeline(cmds, ps, n);
+	for (int i = 0; i < n; i++) {
+		st[i] = (t_stage_stat){.pid = ps[i].pid, .exit_code = -1,
+			.status = ps[i].status, .wall_us = ps[i].wall_us,
+			.user_us = ps[i].user_us, .sys_us = ps[i].sys_us,
+			.maxrss_kb = ps[i].maxrss_kb};
+		if (ps[i].pid > 0 && ps[i].status != -1) {
+			if (WIFEXITED(ps[i].status)) st[i].exit_code = WEXITSTATUS(ps[i].status);
+			if (WIFSIGNALED(ps[i].status)) st[i].signal = WTERMSIG(ps[i].status);
+		}
+		if (st[i].exit_code != 0 && !st[i].signal) exit_code = 1;
 	}
+	free(ps);
 	return (exit_code);
 }
 
@@ -123,5 +169,19 @@ int	picoshell(char **cmds[])
 // 	int result5 = picoshell(cmds5);
 // 	printf("Result: %d\n\n", result5);
 
+// 	// Test 6: seq 1 2000000 | sort -r | head -n 1, con statistiche
+// 	printf("=== Test 6: picoshell_stats ===\n");
+// 	char *cmd12[] = {"seq", "1", "2000000", NULL};
+// 	char *cmd13[] = {"sort", "-r", NULL};
+// 	char *cmd14[] = {"head", "-n", "1", NULL};
+// 	char **cmds6[] = {cmd12, cmd13, cmd14, NULL};
+// 	t_stage_stat st[3];
+// 	int result6 = picoshell_stats(cmds6, st);
+// 	printf("Result: %d\n", result6);
+// 	for (int k = 0; k < 3; k++)
+// 		printf("%-4s pid %d exit %d sig %d wall %lldus user %lldus sys %lldus rss %ldKB\n",
+// 			cmds6[k][0], st[k].pid, st[k].exit_code, st[k].signal, st[k].wall_us,
+// 			st[k].user_us, st[k].sys_us, st[k].maxrss_kb);
+
 // 	return (0);
 // }
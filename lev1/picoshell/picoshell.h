@@ -0,0 +1,109 @@
+#ifndef PICOSHELL_H
+#define PICOSHELL_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+** Varianti estese di picoshell(). cmds ha sempre lo stesso formato:
+** array di argv terminato da NULL.
+*/
+
+/*
+** Opzioni di picoshell_splice:
+**   - pipe_size: capacità richiesta per ogni pipe (F_SETPIPE_SZ),
+**     0 per lasciare quella di default (64 KiB)
+**   - tee_stage: indice dello stadio la cui uscita va duplicata,
+**     -1 per nessun fan-out
+**   - tee_cmds: comandi extra (terminati da NULL) che ricevono una copia
+**     dell'uscita di tee_stage; il loro stdout è quello di picoshell
+*/
+typedef struct s_splice_opts {
+	size_t	pipe_size;
+	int		tee_stage;
+	char	***tee_cmds;
+}	t_splice_opts;
+
+/*
+** Risultato di uno stadio di picoshell_stats:
+**   - pid: -1 se il lancio è fallito
+**   - status: stato grezzo di wait4
+**   - exit_code: WEXITSTATUS, -1 se terminato da un segnale o non
+**     lanciato; signal: WTERMSIG, 0 se è uscito normalmente
+**   - wall_us: tempo reale dal lancio alla terminazione
+**   - user_us, sys_us, maxrss_kb: da struct rusage
+*/
+typedef struct s_stage_stat {
+	pid_t		pid;
+	int			status;
+	int			exit_code;
+	int			signal;
+	long long	wall_us;
+	long long	user_us;
+	long long	sys_us;
+	long		maxrss_kb;
+}	t_stage_stat;
+
+/*
+** Stadio replicato di picoshell_fan: replicas copie dello stesso
+** comando; le righe in ingresso vengono distribuite a turno
+** (FAN_ROUND_ROBIN) o per hash della riga (FAN_HASH), così righe
+** uguali finiscono sempre alla stessa replica. Con ordered le uscite
+** vengono rimesse nell'ordine delle righe in ingresso (richiede un
+** filtro che produca una riga per ogni riga letta), altrimenti le
+** righe escono appena pronte.
+*/
+typedef enum e_fan_split {
+	FAN_ROUND_ROBIN,
+	FAN_HASH
+}	t_fan_split;
+
+typedef struct s_fan_stage {
+	int			replicas;
+	t_fan_split	split;
+	int			ordered;
+}	t_fan_stage;
+
+/*
+** Riga di comando (picoshell_script.c): picoshell_parse riempie cmds
+** con la pipeline di una riga; argv contiene le parole di tutti i
+** comandi, cmds punta dentro argv. Gli array si riusano da una riga
+** all'altra e si liberano con picoshell_cmdline_free. error descrive
+** l'ultimo errore di sintassi.
+*/
+typedef struct s_cmdline {
+	char		***cmds;
+	size_t		cmds_cap;
+	char		**argv;
+	size_t		argv_cap;
+	const char	*error;
+}	t_cmdline;
+
+/*
+** Opzioni di picoshell_script:
+**   - builtins: esegue con picoshell_builtin invece di picoshell
+**   - stop_on_error: si ferma alla prima pipeline fallita (sh -e)
+**   - path_cache: attiva la cache dei PATH (proc_path_cache)
+*/
+typedef struct s_script_opts {
+	int	builtins;
+	int	stop_on_error;
+	int	path_cache;
+}	t_script_opts;
+
+int	picoshell(char **cmds[]);
+int	picoshell_stats(char **cmds[], t_stage_stat *st);
+int	picoshell_splice(char **cmds[], const t_splice_opts *opts,
+		size_t *bytes);
+int	picoshell_fan(char **cmds[], const t_fan_stage *fan);
+int	picoshell_builtin(char **cmds[]);
+int	picoshell_parse(char *line, t_cmdline *cl);
+int	picoshell_script(FILE *f, const t_script_opts *o);
+void	picoshell_cmdline_free(t_cmdline *cl);
+
+/*UTILS*/
+pid_t	pico_spawn(char **argv, int in, int out);
+int		picoshell_is_builtin(char **argv);
+
+#endif
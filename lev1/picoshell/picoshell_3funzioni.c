@@ -14,71 +14,59 @@
 #include <sys/wait.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "../proc/proc.h"
 
 /*
-** execute_child: Esegue il comando nel processo figlio
+** execute_child: Lancia il comando in un processo figlio (proc_spawn)
 **
 ** Parametri:
 **   - cmd: array di stringhe con il comando e i suoi argomenti
 **   - prev: file descriptor dello stdin da un comando precedente (-1 se nessuno)
 **   - fd[2]: pipe per collegare al comando successivo [0]=lettura, [1]=scrittura
 **   - has_next_cmd: flag che indica se c'è un comando successivo
+**   - p: dove salvare pid e stato del figlio
 **
 ** Operazioni:
 **   1. Se esiste un comando precedente (prev != -1):
-**      - Reindirizza lo stdin dal pipe precedente usando dup2()
-**      - Chiude il vecchio file descriptor
+**      - Lo stdin del figlio diventa prev
 **   2. Se esiste un comando successivo (has_next_cmd):
-**      - Reindirizza lo stdout sulla pipe per il prossimo comando
-**   3. Chiude tutti i file descriptor non utilizzati (prevenzione di leak)
-**   4. Esegue il comando con execvp() che sostituisce il processo figlio
-**   5. Se execvp() fallisce, esce con codice 1
+**      - Lo stdout del figlio diventa la pipe per il prossimo comando
+**   3. Le pipe sono O_CLOEXEC (proc_pipe): ogni altro file descriptor
+**      si chiude da solo all'exec, niente close a mano nel figlio
+**   4. posix_spawnp sostituisce fork() + execvp(); se il lancio fallisce
+**      ritorna -1 (come un figlio uscito con 1)
 */
-void	execute_child(char **cmd, int prev, int fd[2], int has_next_cmd)
+int	execute_child(char **cmd, int prev, int fd[2], int has_next_cmd, t_proc *p)
 {
-	if (prev != -1)
-	{
-		if (dup2(prev, STDIN_FILENO) == -1)
-			exit(1);
-		close(prev);
-	}
+	int	io[3] = {prev, -1, -1};
+
 	if (has_next_cmd)
-	{
-		if (dup2(fd[1], STDOUT_FILENO) == -1)
-			exit(1);
-	}
-	close(fd[0]);
-	close(fd[1]);
-	execvp(cmd[0], cmd);
-	exit(1);
+		io[STDOUT_FILENO] = fd[1];
+	return (proc_spawn(p, cmd[0], cmd, io));
 }
 
 /*
-** fork_execute: Crea un nuovo processo figlio e lo configura per eseguire il comando
+** fork_execute: Lancia il comando e aggiorna i file descriptor del padre
 **
 ** Parametri:
 **   - cmd: array di stringhe con il comando e i suoi argomenti
 **   - prev: puntatore al file descriptor dello stdin precedente (viene aggiornato)
 **   - fd[2]: pipe creata per il comando successivo
 **   - has_next_cmd: flag che indica se c'è un comando successivo
+**   - p: dove salvare pid e stato del figlio
 **
 ** Operazioni (nel processo padre):
-**   1. Crea un fork() e controlla se ha successo
-**   2. Nel processo figlio (pid == 0): chiama execute_child()
-**   3. Nel processo padre:
-**      - Chiude il precedente file descriptor di input se era aperto
-**      - Salva il file descriptor di lettura della pipe per il prossimo comando
-**      - Chiude il file descriptor di scrittura (non serve al padre)
+**   1. Lancia il figlio con execute_child()
+**   2. Chiude il precedente file descriptor di input se era aperto
+**   3. Salva il file descriptor di lettura della pipe per il prossimo comando
+**   4. Chiude il file descriptor di scrittura (non serve al padre)
 **
-** Ritorno: 0 in caso di successo, 1 in caso di errore del fork()
+** Ritorno: 0 in caso di successo, 1 se il lancio fallisce
 */
-int	fork_execute(char **cmd, int *prev, int fd[2], int has_next_cmd)
+int	fork_execute(char **cmd, int *prev, int fd[2], int has_next_cmd, t_proc *p)
 {
-	pid_t pid = fork();
-	if (pid == -1)
-		return (close(fd[0]), close(fd[1]), 1);
-	if (pid == 0)
-		execute_child(cmd, *prev, fd, has_next_cmd);
+	int	err = execute_child(cmd, *prev, fd, has_next_cmd, p) == -1;
+
 	if (*prev != -1)
 		close(*prev);
 
@@ -87,7 +75,7 @@ int	fork_execute(char **cmd, int *prev, int fd[2], int has_next_cmd)
 
 	if (has_next_cmd)
 		close(fd[1]);
-	return (0);
+	return (err);
 }
 
 /*
@@ -98,33 +86,46 @@ int	fork_execute(char **cmd, int *prev, int fd[2], int has_next_cmd)
 **           L'ultimo elemento deve essere NULL per marcare la fine
 **
 ** Operazioni:
-**   1. Inizializza fd e prev (prev memorizza il file descriptor del comando precedente)
+**   1. Alloca un t_proc per comando e inizializza prev (prev memorizza il
+**      file descriptor del comando precedente)
 **   2. Per ogni comando in cmds:
-**      - Se non è l'ultimo comando, crea una pipe() per collegarlo al prossimo
-**      - Chiama fork_execute() per creare e eseguire il processo figlio
-**   3. Attende che tutti i processi figli terminino con wait()
+**      - Se non è l'ultimo comando, crea una pipe con proc_pipe() per
+**        collegarlo al prossimo
+**      - Chiama fork_execute() per lanciare il comando
+**   3. Attende i propri figli per pid con proc_wait_all() (wait() potrebbe
+**      raccogliere figli del chiamante che non sono della pipeline)
 **   4. Chiude il file descriptor di input rimasto (se esiste)
 **   5. Ritorna 0 se tutto va bene, 1 se ci sono errori
 */
 int	picoshell(char ***cmds)
 {
-	int	fd[2];
-	int	prev = -1;
-	int	i = -1;
+	int		fd[2];
+	int		prev = -1;
+	int		n = 0;
+	int		ret = 0;
+	t_proc	*ps;
 
-	fd[0] = -1;
-	fd[1] = -1;
-	for (i = 0; cmds[i] != NULL; i++)
+	while (cmds[n])
+		n++;
+	ps = malloc((n ? n : 1) * sizeof(*ps));
+	if (!ps)
+		return (1);
+	for (int i = 0; i < n; i++)
+		ps[i] = (t_proc){.pid = -1, .pidfd = -1};
+	for (int i = 0; i < n; i++)
 	{
-		if (cmds[i + 1] != NULL)
-			pipe(fd);
-		if (fork_execute(cmds[i], &prev, fd, cmds[i + 1]) != NULL)
-			return (1);
+		if (cmds[i + 1] != NULL && proc_pipe(fd, 0) == -1)
+		{
+			ret = 1;
+			break ;
+		}
+		ret |= fork_execute(cmds[i], &prev, fd, cmds[i + 1] != NULL, &ps[i]);
 	}
-	while (wait(NULL) > 0);
 	if (prev >= 0)
 		close(prev);
-	return (0);
+	proc_wait_all(ps, n);
+	free(ps);
+	return (ret);
 }
 
 // int	main()
@@ -0,0 +1,938 @@
+#define _GNU_SOURCE
+#include "picoshell.h"
+#include "../proc/proc.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+/*
+** picoshell_builtin: come picoshell(), ma gli stadi più semplici (cat,
+** echo, head, tr, wc, grep con stringa fissa) non lanciano nessun
+** processo: girano come thread di picoshell. Due stadi interni vicini
+** si passano i dati in un buffer circolare in memoria, senza pipe né
+** chiamate di sistema; tra uno stadio interno e un comando esterno
+** resta una pipe normale.
+**
+**   echo --ring--> tr --ring--> wc -l      (1 processo: picoshell)
+**   seq  --pipe--> grep --ring--> head     (seq è un figlio)
+**
+** Ogni interno ha un parse che controlla gli argomenti prima di
+** partire: se usano qualcosa che l'interno non sa fare (opzioni
+** sconosciute, espressioni regolari, più file...) lo stadio diventa un
+** comando esterno come in picoshell, quindi il risultato non cambia.
+** Stato di uscita: 1 se uno stadio esce con codice != 0 (come
+** picoshell); un interno che trova la pipe chiusa a valle si ferma ed
+** esce con 0, come un figlio ucciso da SIGPIPE.
+*/
+#define RING_SIZE (256 * 1024)
+#define BIO_BUF (64 * 1024)
+#define TR_MAX 4096
+
+/*
+** RING
+** Buffer circolare tra due thread: head è la posizione di lettura, len
+** i byte presenti. writer_done = EOF per chi legge, reader_done = chi
+** legge se n'è andato (per chi scrive è EPIPE).
+*/
+typedef struct s_ring {
+	pthread_mutex_t	lock;
+	pthread_cond_t	readable;
+	pthread_cond_t	writable;
+	char			*buf;
+	size_t			head;
+	size_t			len;
+	int				writer_done;
+	int				reader_done;
+}	t_ring;
+
+static t_ring	*ring_new(void)
+{
+	t_ring	*r = calloc(1, sizeof(*r));
+
+	if (r)
+		r->buf = malloc(RING_SIZE);
+	if (!r || !r->buf)
+		return (free(r), NULL);
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->readable, NULL);
+	pthread_cond_init(&r->writable, NULL);
+	return (r);
+}
+
+static void	ring_free(t_ring *r)
+{
+	if (!r)
+		return ;
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->readable);
+	pthread_cond_destroy(&r->writable);
+	free(r->buf);
+	free(r);
+}
+
+/*
+** Legge al più n byte (solo la parte contigua); 0 a fine dati.
+*/
+static ssize_t	ring_read(t_ring *r, char *dst, size_t n)
+{
+	size_t	k;
+
+	pthread_mutex_lock(&r->lock);
+	while (r->len == 0 && !r->writer_done)
+		pthread_cond_wait(&r->readable, &r->lock);
+	k = r->len < n ? r->len : n;
+	if (k > RING_SIZE - r->head)
+		k = RING_SIZE - r->head;
+	memcpy(dst, r->buf + r->head, k);
+	r->head = (r->head + k) % RING_SIZE;
+	r->len -= k;
+	if (k)
+		pthread_cond_signal(&r->writable);
+	pthread_mutex_unlock(&r->lock);
+	return (k);
+}
+
+/*
+** Scrive tutti gli n byte, aspettando quando il buffer è pieno.
+** Ritorna -1 se chi legge ha chiuso.
+*/
+static int	ring_write(t_ring *r, const char *src, size_t n)
+{
+	size_t	tail;
+	size_t	k;
+
+	pthread_mutex_lock(&r->lock);
+	while (n > 0 && !r->reader_done)
+	{
+		while (r->len == RING_SIZE && !r->reader_done)
+			pthread_cond_wait(&r->writable, &r->lock);
+		tail = (r->head + r->len) % RING_SIZE;
+		k = RING_SIZE - r->len < n ? RING_SIZE - r->len : n;
+		if (k > RING_SIZE - tail)
+			k = RING_SIZE - tail;
+		if (r->reader_done)
+			break ;
+		memcpy(r->buf + tail, src, k);
+		r->len += k;
+		src += k;
+		n -= k;
+		pthread_cond_signal(&r->readable);
+	}
+	pthread_mutex_unlock(&r->lock);
+	return (n > 0 ? -1 : 0);
+}
+
+static void	ring_close(t_ring *r, int reader)
+{
+	pthread_mutex_lock(&r->lock);
+	if (reader)
+		r->reader_done = 1;
+	else
+		r->writer_done = 1;
+	pthread_cond_broadcast(&r->readable);
+	pthread_cond_broadcast(&r->writable);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/*
+** BIO
+** Ingresso o uscita di uno stadio interno: un ring oppure un fd (own se
+** va chiuso a fine stadio; stdin/stdout del chiamante no). In uscita i
+** dati passano da wbuf, così una riga alla volta non costa un lock o
+** una write per riga. broken: chi legge a valle se n'è andato.
+*/
+typedef struct s_bio {
+	int		fd;
+	int		own;
+	t_ring	*ring;
+	char	*wbuf;
+	size_t	wlen;
+	int		broken;
+}	t_bio;
+
+static ssize_t	bio_read(t_bio *b, char *dst, size_t n)
+{
+	ssize_t	r;
+
+	if (b->ring)
+		return (ring_read(b->ring, dst, n));
+	do
+		r = read(b->fd, dst, n);
+	while (r == -1 && errno == EINTR);
+	return (r);
+}
+
+static int	bio_raw_write(t_bio *b, const char *src, size_t n)
+{
+	ssize_t	w;
+
+	if (b->broken)
+		return (-1);
+	if (b->ring && ring_write(b->ring, src, n) == -1)
+		return (b->broken = 1, -1);
+	while (!b->ring && n > 0)
+	{
+		w = write(b->fd, src, n);
+		if (w == -1 && errno == EINTR)
+			continue ;
+		if (w == -1)
+			return (b->broken = 1, -1);
+		src += w;
+		n -= w;
+	}
+	return (0);
+}
+
+static int	bio_flush(t_bio *b)
+{
+	size_t	n = b->wlen;
+
+	b->wlen = 0;
+	return (n ? bio_raw_write(b, b->wbuf, n) : 0);
+}
+
+static int	bio_write(t_bio *b, const char *src, size_t n)
+{
+	if (!b->wbuf)
+		b->wbuf = malloc(BIO_BUF);
+	if (!b->wbuf || n >= BIO_BUF)
+		return (bio_flush(b) ? -1 : bio_raw_write(b, src, n));
+	if (b->wlen + n > BIO_BUF && bio_flush(b))
+		return (-1);
+	memcpy(b->wbuf + b->wlen, src, n);
+	b->wlen += n;
+	return (0);
+}
+
+static void	bio_close(t_bio *b, int reader)
+{
+	if (b->ring)
+		ring_close(b->ring, reader);
+	else if (b->own && b->fd != -1)
+		close(b->fd);
+	b->fd = -1;
+	b->ring = NULL;
+	free(b->wbuf);
+	b->wbuf = NULL;
+}
+
+/*
+** Righe: next_line ritorna la prossima riga in *line (compreso '\n',
+** se c'è) e la sua lunghezza, 0 a fine dati, -1 su errore. La riga
+** resta valida fino alla chiamata successiva. nul diventa 1 appena
+** un blocco letto contiene un byte 0 (dati binari per grep), prima
+** che venga restituita una qualunque riga di quel blocco.
+*/
+typedef struct s_lines {
+	t_bio	*in;
+	char	*buf;
+	size_t	cap;
+	size_t	start;
+	size_t	end;
+	int		eof;
+	int		nul;
+}	t_lines;
+
+static ssize_t	next_line(t_lines *l, char **line)
+{
+	char	*nl;
+	ssize_t	n;
+
+	while (1)
+	{
+		nl = l->end > l->start
+			? memchr(l->buf + l->start, '\n', l->end - l->start) : NULL;
+		if (nl || (l->eof && l->end > l->start))
+		{
+			n = nl ? nl - (l->buf + l->start) + 1 : (ssize_t)(l->end - l->start);
+			*line = l->buf + l->start;
+			l->start += n;
+			return (n);
+		}
+		if (l->eof)
+			return (0);
+		if (l->start > 0)
+		{
+			memmove(l->buf, l->buf + l->start, l->end - l->start);
+			l->end -= l->start;
+			l->start = 0;
+		}
+		if (l->end == l->cap)
+		{
+			char	*tmp = realloc(l->buf, l->cap ? l->cap * 2 : BIO_BUF);
+
+			if (!tmp)
+				return (-1);
+			l->buf = tmp;
+			l->cap = l->cap ? l->cap * 2 : BIO_BUF;
+		}
+		n = bio_read(l->in, l->buf + l->end, l->cap - l->end);
+		if (n < 0)
+			return (-1);
+		l->eof = n == 0;
+		l->nul |= n > 0 && memchr(l->buf + l->end, '\0', n) != NULL;
+		l->end += n;
+	}
+}
+
+/*
+** BUILTIN
+** Opzioni già controllate da parse:
+**   - args: operandi (file per cat, head, wc e grep; parole per echo)
+**   - n: righe di head
+**   - flags: BI_*
+**   - pat/patlen: stringa di grep
+**   - map/del: tabella di tr e byte da cancellare con -d
+*/
+#define BI_NONL 1
+#define BI_LINES 2
+#define BI_WORDS 4
+#define BI_BYTES 8
+#define BI_INVERT 16
+#define BI_COUNT 32
+#define BI_DELETE 64
+
+typedef struct s_bopts {
+	char			**args;
+	long			n;
+	int				flags;
+	const char		*pat;
+	size_t			patlen;
+	unsigned char	map[256];
+	unsigned char	del[256];
+}	t_bopts;
+
+typedef struct s_builtin {
+	const char	*name;
+	int			(*parse)(char **argv, t_bopts *o);
+	int			(*run)(t_bopts *o, t_bio *in, t_bio *out);
+}	t_builtin;
+
+/*
+** Ingresso di uno stadio con operando file: NULL o "-" è lo stdin
+** dello stadio, altrimenti il file viene aperto in tmp.
+*/
+static t_bio	*open_input(const char *file, t_bio *in, t_bio *tmp,
+		const char *who)
+{
+	if (!file || strcmp(file, "-") == 0)
+		return (in);
+	*tmp = (t_bio){.fd = open(file, O_RDONLY | O_CLOEXEC), .own = 1};
+	if (tmp->fd != -1)
+		return (tmp);
+	fprintf(stderr, "%s: %s: %s\n", who, file, strerror(errno));
+	return (NULL);
+}
+
+static int	copy(t_bio *in, t_bio *out)
+{
+	char	buf[BIO_BUF];
+	ssize_t	n;
+
+	while ((n = bio_read(in, buf, sizeof(buf))) > 0)
+		if (bio_write(out, buf, n))
+			return (-1);
+	return (n < 0 ? -1 : 0);
+}
+
+/*
+** Conta gli operandi; le opzioni non previste rendono lo stadio
+** esterno (-1).
+*/
+static int	operands(char **args, int max)
+{
+	int	n = 0;
+
+	while (args[n])
+	{
+		if (args[n][0] == '-' && args[n][1])
+			return (-1);
+		n++;
+	}
+	return (max >= 0 && n > max ? -1 : n);
+}
+
+static int	parse_cat(char **argv, t_bopts *o)
+{
+	o->args = argv + 1;
+	return (operands(o->args, -1) < 0 ? -1 : 0);
+}
+
+static int	run_cat(t_bopts *o, t_bio *in, t_bio *out)
+{
+	int		ret = 0;
+	t_bio	tmp;
+	t_bio	*src;
+
+	if (!o->args[0])
+		return (copy(in, out) && !out->broken);
+	for (int i = 0; o->args[i] && !out->broken; i++)
+	{
+		src = open_input(o->args[i], in, &tmp, "cat");
+		if (!src || copy(src, out))
+			ret = !out->broken;
+		if (src == &tmp)
+			bio_close(&tmp, 1);
+	}
+	return (ret);
+}
+
+static int	parse_echo(char **argv, t_bopts *o)
+{
+	o->args = argv + 1;
+	if (o->args[0] && strcmp(o->args[0], "-n") == 0)
+	{
+		o->flags |= BI_NONL;
+		o->args++;
+	}
+	return (o->args[0] && o->args[0][0] == '-' ? -1 : 0);
+}
+
+static int	run_echo(t_bopts *o, t_bio *in, t_bio *out)
+{
+	(void)in;
+	for (int i = 0; o->args[i]; i++)
+		if ((i && bio_write(out, " ", 1))
+			|| bio_write(out, o->args[i], strlen(o->args[i])))
+			return (0);
+	if (!(o->flags & BI_NONL))
+		bio_write(out, "\n", 1);
+	return (0);
+}
+
+static int	parse_count(const char *s, long *n)
+{
+	char	*end;
+
+	if (!isdigit((unsigned char)*s))
+		return (-1);
+	errno = 0;
+	*n = strtol(s, &end, 10);
+	return (*end || errno ? -1 : 0);
+}
+
+/*
+** head [-n N | -nN | -N] [file]
+*/
+static int	parse_head(char **argv, t_bopts *o)
+{
+	o->n = 10;
+	o->args = argv + 1;
+	if (o->args[0] && strcmp(o->args[0], "-n") == 0)
+	{
+		if (!o->args[1] || parse_count(o->args[1], &o->n))
+			return (-1);
+		o->args += 2;
+	}
+	else if (o->args[0] && o->args[0][0] == '-' && o->args[0][1])
+	{
+		if (parse_count(o->args[0] + 1 + (o->args[0][1] == 'n'), &o->n))
+			return (-1);
+		o->args++;
+	}
+	return (operands(o->args, 1) < 0 ? -1 : 0);
+}
+
+static int	run_head(t_bopts *o, t_bio *in, t_bio *out)
+{
+	t_lines	l = {0};
+	t_bio	tmp;
+	char	*line;
+	ssize_t	n = 1;
+	int		ret = 0;
+
+	l.in = open_input(o->args[0], in, &tmp, "head");
+	if (!l.in)
+		return (1);
+	for (long i = 0; i < o->n && (n = next_line(&l, &line)) > 0; i++)
+		if (bio_write(out, line, n))
+			break ;
+	ret = n < 0;
+	if (l.in == &tmp)
+		bio_close(&tmp, 1);
+	free(l.buf);
+	return (ret);
+}
+
+/*
+** Legge un carattere di un insieme di tr, con gli escape di GNU tr:
+** \\ \a \b \f \n \r \t \v e l'ottale \NNN (da 1 a 3 cifre, al più
+** 0377: "\400" è \40 seguito da '0'). Un altro escape o un backslash
+** finale ritornano -1: lo stadio diventa il tr esterno.
+*/
+static int	tr_char(const char **s, unsigned char *c)
+{
+	static const char	esc[] = "\\\\a\ab\bf\fn\nr\rt\tv\v";
+	const char			*e;
+	unsigned int		v = 0;
+	int					k = 0;
+
+	if (**s != '\\')
+		return (*c = *(*s)++, 0);
+	(*s)++;
+	while (k < 3 && (*s)[k] >= '0' && (*s)[k] <= '7'
+		&& v * 8 + ((*s)[k] - '0') <= 0377)
+		v = v * 8 + ((*s)[k++] - '0');
+	if (k > 0)
+		return (*s += k, *c = v, 0);
+	for (e = esc; **s && *e; e += 2)
+		if (*e == **s)
+			return ((*s)++, *c = e[1], 0);
+	return (-1);
+}
+
+/*
+** Espande un insieme di tr (intervalli a-z, anche con estremi scritti
+** come escape, vedi tr_char) in set. Classi e ripetizioni ([:alpha:],
+** [c*n]) non sono gestite: -1.
+*/
+static int	tr_set(const char *s, unsigned char *set, size_t *len)
+{
+	unsigned char	c;
+	unsigned char	to;
+
+	*len = 0;
+	while (*s)
+	{
+		if (*s == '[' || tr_char(&s, &c))
+			return (-1);
+		to = c;
+		if (s[0] == '-' && s[1] && s[1] != '[')
+		{
+			s++;
+			if (tr_char(&s, &to) || to < c)
+				return (-1);
+		}
+		for (unsigned int k = c; k <= to; k++)
+		{
+			if (*len == TR_MAX)
+				return (-1);
+			set[(*len)++] = k;
+		}
+	}
+	return (0);
+}
+
+/*
+** tr SET1 SET2 | tr -d SET1. Se SET2 è più corto si ripete il suo
+** ultimo carattere, come GNU tr.
+*/
+static int	parse_tr(char **argv, t_bopts *o)
+{
+	unsigned char	s1[TR_MAX];
+	unsigned char	s2[TR_MAX];
+	size_t			n1;
+	size_t			n2;
+	char			**a = argv + 1;
+
+	if (a[0] && strcmp(a[0], "-d") == 0)
+	{
+		o->flags |= BI_DELETE;
+		a++;
+	}
+	if (!a[0] || a[0][0] == '-' || tr_set(a[0], s1, &n1))
+		return (-1);
+	if ((o->flags & BI_DELETE) ? a[1] != NULL
+		: (!a[1] || a[2] || tr_set(a[1], s2, &n2) || n2 == 0))
+		return (-1);
+	for (int c = 0; c < 256; c++)
+		o->map[c] = c;
+	for (size_t i = 0; i < n1; i++)
+	{
+		if (o->flags & BI_DELETE)
+			o->del[s1[i]] = 1;
+		else
+			o->map[s1[i]] = s2[i < n2 ? i : n2 - 1];
+	}
+	return (0);
+}
+
+static int	run_tr(t_bopts *o, t_bio *in, t_bio *out)
+{
+	char	buf[BIO_BUF];
+	ssize_t	n;
+	size_t	k;
+
+	while ((n = bio_read(in, buf, sizeof(buf))) > 0)
+	{
+		k = 0;
+		for (ssize_t i = 0; i < n; i++)
+		{
+			unsigned char	c = buf[i];
+
+			if (!o->del[c])
+				buf[k++] = o->map[c];
+		}
+		if (bio_write(out, buf, k))
+			return (0);
+	}
+	return (n < 0);
+}
+
+/*
+** wc [-l] [-w] [-c] [file]
+*/
+static int	parse_wc(char **argv, t_bopts *o)
+{
+	int	i = 1;
+
+	for (; argv[i] && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		for (int k = 1; argv[i][k]; k++)
+		{
+			if (argv[i][k] == 'l')
+				o->flags |= BI_LINES;
+			else if (argv[i][k] == 'w')
+				o->flags |= BI_WORDS;
+			else if (argv[i][k] == 'c')
+				o->flags |= BI_BYTES;
+			else
+				return (-1);
+		}
+	}
+	if (!o->flags)
+		o->flags = BI_LINES | BI_WORDS | BI_BYTES;
+	o->args = argv + i;
+	return (operands(o->args, 1) < 0 ? -1 : 0);
+}
+
+/*
+** Larghezza dei numeri come GNU wc: una sola cifra minima con un solo
+** contatore, le cifre della dimensione se l'ingresso è un file
+** regolare, altrimenti 7.
+*/
+static int	wc_width(t_bio *src, int one)
+{
+	struct stat	sb;
+	int			w = 1;
+
+	if (one)
+		return (1);
+	if (src->ring || fstat(src->fd, &sb) || !S_ISREG(sb.st_mode))
+		return (7);
+	for (off_t size = sb.st_size; size >= 10; size /= 10)
+		w++;
+	return (w);
+}
+
+static int	run_wc(t_bopts *o, t_bio *in, t_bio *out)
+{
+	char		buf[BIO_BUF];
+	long		cnt[3] = {0};
+	int			flag[3] = {BI_LINES, BI_WORDS, BI_BYTES};
+	int			word = 0;
+	ssize_t		n = 0;
+	t_bio		tmp;
+	t_bio		*src = open_input(o->args[0], in, &tmp, "wc");
+	int			one = !(o->flags & (o->flags - 1));
+	int			len = 0;
+	int			w = src ? wc_width(src, one) : 1;
+
+	while (src && (n = bio_read(src, buf, sizeof(buf))) > 0)
+	{
+		cnt[2] += n;
+		for (ssize_t i = 0; i < n; i++)
+		{
+			cnt[0] += buf[i] == '\n';
+			cnt[1] += !word && !isspace((unsigned char)buf[i]);
+			word = !isspace((unsigned char)buf[i]);
+		}
+	}
+	if (src == &tmp)
+		bio_close(&tmp, 1);
+	if (!src || n < 0)
+		return (1);
+	for (int i = 0; i < 3; i++)
+		if (o->flags & flag[i])
+			len += snprintf(buf + len, sizeof(buf) - len, "%s%*ld",
+					len ? " " : "", w, cnt[i]);
+	if (o->args[0])
+		len += snprintf(buf + len, sizeof(buf) - len, " %s", o->args[0]);
+	buf[len++] = '\n';
+	bio_write(out, buf, len);
+	return (0);
+}
+
+/*
+** grep [-F] [-v] [-c] PATTERN [file], solo stringhe fisse: senza -F
+** un pattern con metacaratteri lo fa il grep esterno, e così un
+** pattern con '\n' (per GNU sono più pattern, uno per riga).
+*/
+static int	parse_grep(char **argv, t_bopts *o)
+{
+	int	i = 1;
+	int	fixed = 0;
+
+	for (; argv[i] && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if (strcmp(argv[i], "--") == 0)
+		{
+			i++;
+			break ;
+		}
+		for (int k = 1; argv[i][k]; k++)
+		{
+			if (argv[i][k] == 'F')
+				fixed = 1;
+			else if (argv[i][k] == 'v')
+				o->flags |= BI_INVERT;
+			else if (argv[i][k] == 'c')
+				o->flags |= BI_COUNT;
+			else
+				return (-1);
+		}
+	}
+	if (!argv[i] || strchr(argv[i], '\n')
+		|| (!fixed && strpbrk(argv[i], ".[]*^$\\")))
+		return (-1);
+	o->pat = argv[i];
+	o->patlen = strlen(argv[i]);
+	o->args = argv + i + 1;
+	return (operands(o->args, 1) < 0 ? -1 : 0);
+}
+
+/*
+** Dati binari (un byte 0, vedi t_lines) come GNU grep >= 3.5: da lì in
+** poi nessuna riga in uscita, la prima riga selezionata diventa
+** "binary file matches" su stderr e la lettura si ferma; -c conta
+** tutto come prima.
+*/
+static int	run_grep(t_bopts *o, t_bio *in, t_bio *out)
+{
+	t_lines	l = {0};
+	t_bio	tmp;
+	char	*line;
+	ssize_t	n;
+	long	found = 0;
+	char	num[32];
+
+	l.in = open_input(o->args[0], in, &tmp, "grep");
+	if (!l.in)
+		return (2);
+	while ((n = next_line(&l, &line)) > 0)
+	{
+		size_t	len = n - (line[n - 1] == '\n');
+		int		hit = memmem(line, len, o->pat, o->patlen) != NULL;
+
+		if (hit != !(o->flags & BI_INVERT) || (++found && o->flags & BI_COUNT))
+			continue ;
+		if (l.nul)
+			fprintf(stderr, "grep: %s: binary file matches\n", l.in == in
+				? "(standard input)" : o->args[0]);
+		if (l.nul || bio_write(out, line, len) || bio_write(out, "\n", 1))
+			break ;
+	}
+	if (l.in == &tmp)
+		bio_close(&tmp, 1);
+	free(l.buf);
+	if (o->flags & BI_COUNT)
+		bio_write(out, num, snprintf(num, sizeof(num), "%ld\n", found));
+	if (n < 0)
+		return (2);
+	return (found == 0 && !out->broken);
+}
+
+static const t_builtin	g_builtins[] = {
+	{"cat", parse_cat, run_cat},
+	{"echo", parse_echo, run_echo},
+	{"head", parse_head, run_head},
+	{"tr", parse_tr, run_tr},
+	{"wc", parse_wc, run_wc},
+	{"grep", parse_grep, run_grep},
+};
+
+static const t_builtin	*find_builtin(char **argv, t_bopts *o)
+{
+	for (size_t i = 0; argv[0] && i < sizeof(g_builtins) / sizeof(*g_builtins); i++)
+	{
+		if (strcmp(argv[0], g_builtins[i].name))
+			continue ;
+		*o = (t_bopts){0};
+		return (g_builtins[i].parse(argv, o) ? NULL : &g_builtins[i]);
+	}
+	return (NULL);
+}
+
+/*
+** picoshell_is_builtin: 1 se argv girerebbe dentro picoshell_builtin.
+*/
+int	picoshell_is_builtin(char **argv)
+{
+	t_bopts	o;
+
+	return (find_builtin(argv, &o) != NULL);
+}
+
+/*
+** ESECUZIONE
+** Stadio: bi NULL per un comando esterno (proc), altrimenti un thread.
+*/
+typedef struct s_bstage {
+	const t_builtin	*bi;
+	t_bopts			o;
+	t_bio			in;
+	t_bio			out;
+	t_proc			proc;
+	pthread_t		tid;
+	int				started;
+	int				code;
+}	t_bstage;
+
+static void	*stage_run(void *arg)
+{
+	t_bstage	*s = arg;
+
+	s->code = s->bi->run(&s->o, &s->in, &s->out);
+	bio_flush(&s->out);
+	bio_close(&s->in, 1);
+	bio_close(&s->out, 0);
+	return (NULL);
+}
+
+/*
+** Collega ogni stadio al successivo: ring tra due interni, pipe
+** O_CLOEXEC altrimenti. rings riceve i ring da liberare alla fine.
+*/
+static int	connect_stages(t_bstage *st, int n, t_ring **rings)
+{
+	int	fd[2];
+
+	st[0].in = (t_bio){.fd = STDIN_FILENO};
+	st[n - 1].out = (t_bio){.fd = STDOUT_FILENO};
+	for (int i = 0; i + 1 < n; i++)
+	{
+		if (st[i].bi && st[i + 1].bi)
+		{
+			rings[i] = ring_new();
+			if (!rings[i])
+				return (-1);
+			st[i].out = (t_bio){.fd = -1, .ring = rings[i]};
+			st[i + 1].in = (t_bio){.fd = -1, .ring = rings[i]};
+			continue ;
+		}
+		if (proc_pipe(fd, 0) == -1)
+			return (-1);
+		st[i].out = (t_bio){.fd = fd[1], .own = 1};
+		st[i + 1].in = (t_bio){.fd = fd[0], .own = 1};
+	}
+	return (0);
+}
+
+/*
+** Lancia prima i comandi esterni (i loro fd nel padre si chiudono
+** subito), poi i thread con SIGPIPE bloccato: un interno che scrive su
+** una pipe senza lettori riceve EPIPE invece di uccidere picoshell.
+*/
+static void	start_stages(t_bstage *st, int n, char **cmds[])
+{
+	sigset_t	set;
+	sigset_t	old;
+
+	for (int i = 0; i < n; i++)
+	{
+		if (st[i].bi)
+			continue ;
+		if (proc_spawn(&st[i].proc, cmds[i][0], cmds[i], (int [3]){
+				st[i].in.own ? st[i].in.fd : -1,
+				st[i].out.own ? st[i].out.fd : -1, -1}) == -1)
+			st[i].code = 1;
+		bio_close(&st[i].in, 1);
+		bio_close(&st[i].out, 0);
+	}
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	for (int i = 0; i < n; i++)
+	{
+		if (!st[i].bi)
+			continue ;
+		st[i].started = !pthread_create(&st[i].tid, NULL, stage_run, &st[i]);
+		if (st[i].started)
+			continue ;
+		st[i].code = 1;
+		bio_close(&st[i].in, 1);
+		bio_close(&st[i].out, 0);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static int	finish_stages(t_bstage *st, int n, t_ring **rings)
+{
+	int	exit_code = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		if (st[i].started)
+			pthread_join(st[i].tid, NULL);
+		if (!st[i].bi && st[i].proc.pid > 0)
+		{
+			proc_wait(&st[i].proc, 0);
+			st[i].code = WIFEXITED(st[i].proc.status)
+				? WEXITSTATUS(st[i].proc.status) : 0;
+		}
+		exit_code |= st[i].code != 0;
+		bio_close(&st[i].in, 1);
+		bio_close(&st[i].out, 0);
+	}
+	for (int i = 0; i + 1 < n; i++)
+		ring_free(rings[i]);
+	return (exit_code);
+}
+
+int	picoshell_builtin(char **cmds[])
+{
+	t_bstage	*st;
+	t_ring		**rings;
+	int			n = 0;
+	int			exit_code;
+
+	while (cmds[n])
+		n++;
+	if (n == 0)
+		return (0);
+	st = calloc(n, sizeof(*st));
+	rings = calloc(n, sizeof(*rings));
+	if (!st || !rings)
+		return (free(st), free(rings), 1);
+	for (int i = 0; i < n; i++)
+	{
+		st[i].bi = find_builtin(cmds[i], &st[i].o);
+		st[i].in = (t_bio){.fd = -1};
+		st[i].out = (t_bio){.fd = -1};
+		st[i].proc = (t_proc){.pid = -1, .pidfd = -1};
+	}
+	fflush(NULL);
+	exit_code = connect_stages(st, n, rings) == -1;
+	if (exit_code == 0)
+		start_stages(st, n, cmds);
+	exit_code |= finish_stages(st, n, rings);
+	free(rings);
+	free(st);
+	return (exit_code);
+}
+
+// int	main(void)
+// {
+// 	char	*echo[] = {"echo", "squalala", NULL};
+// 	char	*tr[] = {"tr", "a", "b", NULL};
+// 	char	*seq[] = {"seq", "1", "1000000", NULL};
+// 	char	*grep[] = {"grep", "77", NULL};
+// 	char	*head[] = {"head", "-n", "3", NULL};
+// 	char	*wc[] = {"wc", "-l", NULL};
+// 	char	*sort[] = {"sort", "-r", NULL};
+// 	char	**cmds1[] = {echo, tr, NULL};			// squblblb, 0 processi
+// 	char	**cmds2[] = {seq, grep, head, NULL};	// 77 177 277
+// 	char	**cmds3[] = {seq, grep, sort, wc, NULL};	// 45739
+// 	printf("Result: %d\n", picoshell_builtin(cmds1));
+// 	printf("Result: %d\n", picoshell_builtin(cmds2));
+// 	printf("Result: %d\n", picoshell_builtin(cmds3));
+// 	return (0);
+// }
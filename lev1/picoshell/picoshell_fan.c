@@ -0,0 +1,613 @@
+#define _GNU_SOURCE
+#include "picoshell.h"
+#include "../proc/proc.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+/*
+** picoshell_fan: pipeline in cui uno stadio può girare in più copie.
+** Per uno stadio con replicas > 1 picoshell tiene due thread:
+**
+**            +--> replica0 --+
+**   in --> [split] --> replica1 --> [merge] --> out
+**            +--> replica2 --+
+**
+**   - split legge le righe in ingresso e le assegna alle repliche
+**     (a turno o per hash), accumulandole in un buffer per replica
+**     scritto a blocchi, non una write per riga
+**   - merge legge con poll() da tutte le repliche in buffer propri e
+**     scrive solo righe intere, così le uscite non si mescolano a metà
+**     riga. Legge sempre tutto quello che arriva, anche in modalità
+**     ordinata: se aspettasse una replica sola, le altre si
+**     bloccherebbero sulla pipe piena e split con loro
+**   - in modalità ordinata split registra in un log la replica scelta
+**     per ogni riga (prima di scriverla) e merge emette le righe
+**     seguendo il log
+**
+** Gli stadi normali sono collegati direttamente come in picoshell.
+** Una replica che esce chiude la sua pipe: split smette di mandarle
+** righe e le sue voci del log vengono saltate.
+*/
+#define FAN_CHUNK (64 * 1024)
+
+typedef struct s_buf {
+	char	*v;
+	size_t	off;
+	size_t	len;
+	size_t	cap;
+}	t_buf;
+
+typedef struct s_fan {
+	t_fan_stage		cfg;
+	int				in;
+	int				out;
+	int				*to;
+	int				*from;
+	t_buf			*wbuf;
+	t_buf			*rbuf;
+	char			*eof;
+	int				*log;
+	size_t			log_head;
+	size_t			log_len;
+	size_t			log_cap;
+	int				split_done;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	pthread_t		split_tid;
+	pthread_t		merge_tid;
+	int				started;
+	int				err;
+}	t_fan;
+
+/*
+** Garantisce spazio per almeno extra byte dopo len, compattando prima
+** i byte già consumati (off).
+*/
+static int	buf_reserve(t_buf *b, size_t extra)
+{
+	if (b->off)
+	{
+		memmove(b->v, b->v + b->off, b->len - b->off);
+		b->len -= b->off;
+		b->off = 0;
+	}
+	if (b->len + extra > b->cap)
+	{
+		size_t	cap = b->cap ? b->cap : FAN_CHUNK;
+		char	*tmp;
+
+		while (cap < b->len + extra)
+			cap *= 2;
+		tmp = realloc(b->v, cap);
+		if (!tmp)
+			return (-1);
+		b->v = tmp;
+		b->cap = cap;
+	}
+	return (0);
+}
+
+static int	buf_append(t_buf *b, const char *s, size_t n)
+{
+	if (buf_reserve(b, n))
+		return (-1);
+	memcpy(b->v + b->len, s, n);
+	b->len += n;
+	return (0);
+}
+
+static int	write_all(int fd, const char *buf, size_t n)
+{
+	while (n > 0)
+	{
+		ssize_t	w = write(fd, buf, n);
+		if (w == -1 && errno == EINTR)
+			continue ;
+		if (w == -1)
+			return (-1);
+		buf += w;
+		n -= w;
+	}
+	return (0);
+}
+
+static void	close_fd(int *fd)
+{
+	if (*fd != -1)
+		close(*fd);
+	*fd = -1;
+}
+
+/*
+** SPLIT
+*/
+static size_t	hash_line(const char *s, size_t len)
+{
+	size_t	h = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+	return (h);
+}
+
+/*
+** Sceglie la replica per una riga (senza '\n'), saltando quelle
+** uscite. Ritorna -1 se non ne resta nessuna.
+*/
+static int	pick(t_fan *f, const char *line, size_t len, int *rr)
+{
+	int	k = f->cfg.replicas;
+	int	r;
+
+	if (f->cfg.split == FAN_HASH)
+		r = hash_line(line, len) % k;
+	else
+	{
+		r = *rr;
+		*rr = (r + 1) % k;
+	}
+	for (int i = 0; i < k; i++, r = (r + 1) % k)
+		if (f->to[r] != -1)
+			return (r);
+	return (-1);
+}
+
+static void	flush(t_fan *f, int r)
+{
+	t_buf	*b = &f->wbuf[r];
+
+	if (b->len && f->to[r] != -1 && write_all(f->to[r], b->v, b->len))
+		close_fd(&f->to[r]);
+	b->len = 0;
+}
+
+static int	log_push(t_fan *f, int r)
+{
+	int	ret = 0;
+
+	pthread_mutex_lock(&f->lock);
+	if (f->log_len == f->log_cap)
+	{
+		size_t	cap = f->log_cap ? f->log_cap * 2 : 4096;
+		int		*tmp = realloc(f->log, cap * sizeof(*tmp));
+
+		if (tmp)
+			f->log = tmp;
+		if (tmp)
+			f->log_cap = cap;
+		ret = tmp ? 0 : -1;
+	}
+	if (ret == 0)
+		f->log[f->log_len++] = r;
+	pthread_mutex_unlock(&f->lock);
+	return (ret);
+}
+
+/*
+** Distribuisce le righe complete di in (con last anche l'ultima senza
+** '\n') e tiene il resto per la lettura successiva.
+** Ritorna 0 se non resta nessuna replica o in caso di errore.
+*/
+static int	split_lines(t_fan *f, t_buf *in, int *rr, int last)
+{
+	char	*p = in->v;
+	char	*end = in->v + in->len;
+
+	while (p < end)
+	{
+		char	*nl = memchr(p, '\n', end - p);
+		size_t	len = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+		int		r;
+
+		if (!nl && !last)
+			break ;
+		r = pick(f, p, nl ? len - 1 : len, rr);
+		if (r == -1)
+			return (0);
+		if ((f->cfg.ordered && log_push(f, r))
+			|| buf_append(&f->wbuf[r], p, len))
+			return (f->err = 1, 0);
+		if (f->wbuf[r].len >= FAN_CHUNK)
+			flush(f, r);
+		p += len;
+	}
+	memmove(in->v, p, end - p);
+	in->len = end - p;
+	for (int r = 0; r < f->cfg.replicas; r++)
+		flush(f, r);
+	return (1);
+}
+
+static void	*split_run(void *arg)
+{
+	t_fan	*f = arg;
+	t_buf	in = {0};
+	int		rr = 0;
+	int		alive = 1;
+	ssize_t	n;
+
+	while (alive)
+	{
+		if (buf_reserve(&in, FAN_CHUNK))
+		{
+			f->err = 1;
+			break ;
+		}
+		n = read(f->in, in.v + in.len, FAN_CHUNK);
+		if (n == -1 && errno == EINTR)
+			continue ;
+		if (n <= 0)
+		{
+			f->err |= n == -1;
+			break ;
+		}
+		in.len += n;
+		alive = split_lines(f, &in, &rr, 0);
+	}
+	if (alive && in.len)
+		split_lines(f, &in, &rr, 1);
+	for (int r = 0; r < f->cfg.replicas; r++)
+		close_fd(&f->to[r]);
+	close_fd(&f->in);
+	free(in.v);
+	pthread_mutex_lock(&f->lock);
+	f->split_done = 1;
+	pthread_cond_broadcast(&f->cond);
+	pthread_mutex_unlock(&f->lock);
+	return (NULL);
+}
+
+/*
+** MERGE
+*/
+
+/*
+** Senza ordine: di ogni replica escono le righe complete (a fine
+** replica anche l'ultima parziale).
+*/
+static int	emit_any(t_fan *f)
+{
+	for (int r = 0; r < f->cfg.replicas; r++)
+	{
+		t_buf	*b = &f->rbuf[r];
+		size_t	n = b->len - b->off;
+
+		while (n > 0 && !f->eof[r] && b->v[b->off + n - 1] != '\n')
+			n--;
+		if (n && write_all(f->out, b->v + b->off, n))
+			return (-1);
+		b->off += n;
+	}
+	return (0);
+}
+
+/*
+** In ordine: segue il log finché la replica in testa ha una riga
+** completa. Le righe vengono raccolte in out e scritte fuori dal lock.
+*/
+static int	emit_ordered(t_fan *f, t_buf *out)
+{
+	pthread_mutex_lock(&f->lock);
+	while (f->log_head < f->log_len)
+	{
+		int		r = f->log[f->log_head];
+		t_buf	*b = &f->rbuf[r];
+		size_t	n = b->len - b->off;
+		char	*nl = n ? memchr(b->v + b->off, '\n', n) : NULL;
+
+		if (!nl && !f->eof[r])
+			break ;
+		if (nl)
+			n = nl - (b->v + b->off) + 1;
+		if (n && buf_append(out, b->v + b->off, n))
+			break ;
+		b->off += n;
+		f->log_head++;
+	}
+	if (f->log_head >= 4096 && f->log_head * 2 >= f->log_len)
+	{
+		memmove(f->log, f->log + f->log_head,
+			(f->log_len - f->log_head) * sizeof(*f->log));
+		f->log_len -= f->log_head;
+		f->log_head = 0;
+	}
+	pthread_mutex_unlock(&f->lock);
+	if (out->len && write_all(f->out, out->v, out->len))
+		return (-1);
+	out->len = 0;
+	return (0);
+}
+
+static int	emit(t_fan *f, t_buf *out)
+{
+	return (f->cfg.ordered ? emit_ordered(f, out) : emit_any(f));
+}
+
+static int	merge_read(t_fan *f, int r)
+{
+	t_buf	*b = &f->rbuf[r];
+	ssize_t	n;
+
+	if (buf_reserve(b, FAN_CHUNK))
+		return (f->err = 1, -1);
+	n = read(f->from[r], b->v + b->len, FAN_CHUNK);
+	if (n > 0)
+		b->len += n;
+	else if (n == 0 || errno != EINTR)
+	{
+		close_fd(&f->from[r]);
+		f->eof[r] = 1;
+	}
+	return (0);
+}
+
+static void	*merge_run(void *arg)
+{
+	t_fan			*f = arg;
+	int				k = f->cfg.replicas;
+	struct pollfd	*pfd = calloc(k, sizeof(*pfd));
+	t_buf			out = {0};
+	int				open = 0;
+	int				stop = !pfd;
+
+	for (int r = 0; pfd && r < k; r++)
+	{
+		f->eof[r] = f->from[r] == -1;
+		open += !f->eof[r];
+	}
+	while (!stop && open > 0)
+	{
+		for (int r = 0; r < k; r++)
+			pfd[r] = (struct pollfd){.fd = f->from[r], .events = POLLIN};
+		if (poll(pfd, k, -1) == -1 && errno != EINTR)
+			break ;
+		for (int r = 0; r < k && !stop; r++)
+		{
+			if (pfd[r].fd == -1 || !pfd[r].revents)
+				continue ;
+			stop = merge_read(f, r);
+			open -= f->eof[r];
+		}
+		stop = stop || emit(f, &out);
+	}
+	pthread_mutex_lock(&f->lock);
+	while (!stop && f->cfg.ordered && !f->split_done)
+		pthread_cond_wait(&f->cond, &f->lock);
+	pthread_mutex_unlock(&f->lock);
+	if (!stop)
+		emit(f, &out);
+	for (int r = 0; r < k; r++)
+		close_fd(&f->from[r]);
+	close_fd(&f->out);
+	free(out.v);
+	free(pfd);
+	return (NULL);
+}
+
+/*
+** SETUP
+*/
+static int	fan_alloc(t_fan *f, const t_fan_stage *cfg)
+{
+	int	k = cfg->replicas;
+
+	f->cfg = *cfg;
+	f->in = -1;
+	f->out = -1;
+	pthread_mutex_init(&f->lock, NULL);
+	pthread_cond_init(&f->cond, NULL);
+	f->to = malloc(2 * k * sizeof(*f->to));
+	f->wbuf = calloc(2 * k, sizeof(*f->wbuf));
+	f->eof = calloc(k, 1);
+	if (!f->to || !f->wbuf || !f->eof)
+		return (-1);
+	f->from = f->to + k;
+	f->rbuf = f->wbuf + k;
+	for (int r = 0; r < 2 * k; r++)
+		f->to[r] = -1;
+	return (0);
+}
+
+/*
+** Prende in carico in/out (-1 = stdin/stdout di picoshell, duplicati)
+** e lancia le repliche. Una replica che non parte resta chiusa come
+** una replica uscita. Ritorna il numero di figli aggiunti a ps.
+*/
+static int	fan_spawn(t_fan *f, char **cmd, int in, int out, t_proc *ps)
+{
+	int	a[2];
+	int	b[2];
+	int	n = 0;
+
+	f->in = in != -1 ? in : fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+	f->out = out != -1 ? out : fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+	for (int r = 0; r < f->cfg.replicas; r++)
+	{
+		if (proc_pipe(a, 0) == -1)
+			break ;
+		if (proc_pipe(b, 0) == -1)
+		{
+			close(a[0]);
+			close(a[1]);
+			break ;
+		}
+		proc_spawn(&ps[n], cmd[0], cmd, (int [3]){a[0], b[1], -1});
+		close(a[0]);
+		close(b[1]);
+		f->to[r] = a[1];
+		f->from[r] = b[0];
+		if (ps[n].pid != -1)
+			n++;
+		else
+		{
+			close_fd(&f->to[r]);
+			close_fd(&f->from[r]);
+		}
+	}
+	if (n < f->cfg.replicas)
+		f->err = 1;
+	return (n);
+}
+
+static void	fan_close(t_fan *f)
+{
+	for (int r = 0; f->to && r < 2 * f->cfg.replicas; r++)
+		close_fd(&f->to[r]);
+	close_fd(&f->in);
+	close_fd(&f->out);
+}
+
+static void	fan_free(t_fan *f)
+{
+	if (f->cfg.replicas <= 1)
+		return ;
+	fan_close(f);
+	for (int r = 0; f->wbuf && r < 2 * f->cfg.replicas; r++)
+		free(f->wbuf[r].v);
+	pthread_mutex_destroy(&f->lock);
+	pthread_cond_destroy(&f->cond);
+	free(f->to);
+	free(f->wbuf);
+	free(f->eof);
+	free(f->log);
+}
+
+/*
+** Avvia split e merge di ogni stadio replicato. SIGPIPE è bloccato
+** mentre si creano i thread (lo ereditano): un lettore uscito diventa
+** EPIPE invece di uccidere picoshell. I figli sono già lanciati, quindi
+** non ereditano la maschera. Uno stadio che non parte chiude subito le
+** sue pipe, altrimenti le repliche aspetterebbero l'EOF per sempre.
+*/
+static void	fan_start(t_fan *fans, int n, int *err)
+{
+	sigset_t	set;
+	sigset_t	old;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	for (int i = 0; i < n; i++)
+	{
+		t_fan	*f = &fans[i];
+
+		if (f->cfg.replicas <= 1)
+			continue ;
+		if (!f->to || f->in == -1 || f->out == -1
+			|| pthread_create(&f->split_tid, NULL, split_run, f))
+		{
+			*err = 1;
+			fan_close(f);
+		}
+		else if (pthread_create(&f->merge_tid, NULL, merge_run, f))
+		{
+			*err = 1;
+			for (int r = 0; r < f->cfg.replicas; r++)
+				close_fd(&f->from[r]);
+			pthread_join(f->split_tid, NULL);
+			fan_close(f);
+		}
+		else
+			f->started = 1;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static int	count_procs(char **cmds[], const t_fan_stage *fan, int *n)
+{
+	int	total = 0;
+
+	for (*n = 0; cmds[*n]; (*n)++)
+		total += fan && fan[*n].replicas > 1 ? fan[*n].replicas : 1;
+	return (total);
+}
+
+/*
+** fan, se non NULL, ha un elemento per comando; replicas <= 1 indica
+** uno stadio normale. Ritorna 1 se un processo esce con codice != 0 o
+** se qualcosa fallisce, altrimenti 0 (come picoshell).
+*/
+int	picoshell_fan(char **cmds[], const t_fan_stage *fan)
+{
+	int		n;
+	int		total = count_procs(cmds, fan, &n);
+	t_fan	*fans = calloc(n ? n : 1, sizeof(*fans));
+	t_proc	*ps = malloc((total ? total : 1) * sizeof(*ps));
+	int		np = 0;
+	int		prev = -1;
+	int		err = !fans || !ps;
+	int		p[2];
+
+	for (int i = 0; i < n && !err; i++)
+	{
+		if (cmds[i + 1] && proc_pipe(p, 0) == -1)
+		{
+			err = 1;
+			break ;
+		}
+		if (fan && fan[i].replicas > 1 && fan_alloc(&fans[i], &fan[i]))
+		{
+			err = 1;
+			close_fd(&prev);
+			if (cmds[i + 1])
+				close(p[1]);
+		}
+		else if (fan && fan[i].replicas > 1)
+			np += fan_spawn(&fans[i], cmds[i], prev, cmds[i + 1] ? p[1] : -1,
+					ps + np);
+		else
+		{
+			err |= proc_spawn(&ps[np], cmds[i][0], cmds[i],
+					(int [3]){prev, cmds[i + 1] ? p[1] : -1, -1}) == -1;
+			np += ps[np].pid != -1;
+			close_fd(&prev);
+			if (cmds[i + 1])
+				close(p[1]);
+		}
+		prev = cmds[i + 1] ? p[0] : -1;
+	}
+	close_fd(&prev);
+	if (fans)
+		fan_start(fans, n, &err);
+	if (ps)
+		proc_wait_all(ps, np);
+	for (int i = 0; i < np; i++)
+		if (proc_wait(&ps[i], 0) == -1
+			|| (WIFEXITED(ps[i].status) && WEXITSTATUS(ps[i].status) != 0))
+			err = 1;
+	for (int i = 0; fans && i < n; i++)
+	{
+		if (fans[i].started)
+		{
+			pthread_join(fans[i].split_tid, NULL);
+			pthread_join(fans[i].merge_tid, NULL);
+		}
+		err |= fans[i].err;
+		fan_free(&fans[i]);
+	}
+	free(fans);
+	free(ps);
+	return (err);
+}
+
+// int	main(void)
+// {
+// 	char		*gen[] = {"seq", "1", "100000", NULL};
+// 	char		*filt[] = {"sed", "s/$/!/", NULL};
+// 	char		*tail[] = {"tail", "-n", "2", NULL};
+// 	char		**cmds[] = {gen, filt, tail, NULL};
+// 	t_fan_stage	fan[] = {{0}, {.replicas = 4, .ordered = 1}, {0}};
+// 	int			res;
+
+// 	res = picoshell_fan(cmds, fan);				// 99999! e 100000!
+// 	printf("Result: %d\n", res);
+// 	return (0);
+// }
@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+#include "picoshell.h"
+#include "../proc/proc.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+** Riga di comando per picoshell: picoshell_parse trasforma una riga
+** "a | b 'c d' | e" nel solito cmds[], picoshell_script esegue un file
+** di righe una dopo l'altra.
+**
+** Sintassi (un sottoinsieme di sh):
+**   - parole separate da spazi o tab, comandi separati da '|'
+**   - '...': tutto letterale fino al prossimo '
+**   - "...": letterale, tranne \" \\ \$ \` che perdono il backslash
+**   - \x fuori dalle virgolette: x letterale (anche spazio, | o #)
+**   - # a inizio parola: commento fino a fine riga
+** Niente variabili, redirezioni, glob o && ||: "a || b" è un errore
+** (comando vuoto tra le due |).
+**
+** Allocazioni: nessuna per parola. Le parole vengono riscritte senza
+** virgolette dentro la riga stessa (il risultato non è mai più lungo
+** del testo originale) e argv punta lì dentro; argv e cmds stanno in
+** t_cmdline e crescono solo quando una riga ha più parole o comandi di
+** tutte le precedenti, quindi in uno script servono pochi realloc in
+** tutto.
+*/
+
+static int	is_blank(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+static int	push_arg(t_cmdline *cl, size_t *n, char *arg)
+{
+	char	**tmp;
+	size_t	cap;
+
+	if (*n == cl->argv_cap)
+	{
+		cap = cl->argv_cap ? cl->argv_cap * 2 : 32;
+		tmp = realloc(cl->argv, cap * sizeof(*tmp));
+		if (!tmp)
+			return (-1);
+		cl->argv = tmp;
+		cl->argv_cap = cap;
+	}
+	cl->argv[(*n)++] = arg;
+	return (0);
+}
+
+/*
+** Legge una parola da *r e la riscrive senza virgolette a partire da
+** *r stesso. Ritorna il carattere che l'ha chiusa (spazio, '|' o '\0'),
+** -1 per virgolette non chiuse. *r resta sul terminatore.
+*/
+static int	read_word(char **r)
+{
+	char	*s = *r;
+	char	*w = *r;
+	char	q;
+
+	while (*s && !is_blank(*s) && *s != '|')
+	{
+		if (*s == '\'' || *s == '"')
+		{
+			q = *s++;
+			while (*s && *s != q)
+			{
+				if (q == '"' && *s == '\\' && s[1] && strchr("\"\\$`", s[1]))
+					s++;
+				*w++ = *s++;
+			}
+			if (!*s++)
+				return (-1);
+		}
+		else if (*s == '\\' && s[1])
+		{
+			*w++ = s[1];
+			s += 2;
+		}
+		else
+			*w++ = *s++;
+	}
+	q = *s;
+	*w = '\0';
+	*r = s;
+	return ((unsigned char)q);
+}
+
+/*
+** Dopo il parse argv contiene gli argv dei comandi uno dopo l'altro,
+** ognuno chiuso da NULL: cmds[i] punta all'inizio dell'i-esimo.
+*/
+static int	fill_cmds(t_cmdline *cl, size_t nargs)
+{
+	size_t	n = 0;
+	char	***tmp;
+
+	for (size_t i = 0; i < nargs; i++)
+		n += cl->argv[i] == NULL;
+	if (n + 1 > cl->cmds_cap)
+	{
+		tmp = realloc(cl->cmds, (n + 1) * sizeof(*tmp));
+		if (!tmp)
+			return (-1);
+		cl->cmds = tmp;
+		cl->cmds_cap = n + 1;
+	}
+	n = 0;
+	for (size_t i = 0; i < nargs; i++)
+		if (i == 0 || cl->argv[i - 1] == NULL)
+			cl->cmds[n++] = &cl->argv[i];
+	cl->cmds[n] = NULL;
+	return ((int)n);
+}
+
+/*
+** picoshell_parse: analizza line (che viene modificata e deve restare
+** viva finché si usa cl->cmds). Ritorna il numero di comandi (0 per una
+** riga vuota o solo commento) con cl->cmds pronto per picoshell, -1 per
+** errore di sintassi (cl->error dice quale) o memoria esaurita.
+*/
+int	picoshell_parse(char *line, t_cmdline *cl)
+{
+	size_t	nargs = 0;
+	size_t	words = 0;
+	char	*r = line;
+	int		end;
+
+	cl->error = NULL;
+	while (1)
+	{
+		while (is_blank(*r))
+			r++;
+		if (*r == '\0' || *r == '#')
+			break ;
+		if (*r == '|')
+		{
+			if (words == 0)
+				return (cl->error = "empty command", -1);
+			if (push_arg(cl, &nargs, NULL) == -1)
+				return (cl->error = "out of memory", -1);
+			words = 0;
+			r++;
+			continue ;
+		}
+		if (push_arg(cl, &nargs, r) == -1)
+			return (cl->error = "out of memory", -1);
+		words++;
+		end = read_word(&r);
+		if (end == -1)
+			return (cl->error = "unterminated quote", -1);
+		if (end == '|' && push_arg(cl, &nargs, NULL) == -1)
+			return (cl->error = "out of memory", -1);
+		if (end == '|')
+			words = 0;
+		if (end != '\0')
+			r++;
+	}
+	if (nargs > 0 && words == 0)
+		return (cl->error = "empty command", -1);
+	if ((nargs > 0 && push_arg(cl, &nargs, NULL) == -1)
+		|| (end = fill_cmds(cl, nargs)) == -1)
+		return (cl->error = "out of memory", -1);
+	return (end);
+}
+
+void	picoshell_cmdline_free(t_cmdline *cl)
+{
+	free(cl->argv);
+	free(cl->cmds);
+	*cl = (t_cmdline){0};
+}
+
+/*
+** picoshell_script: esegue le righe di f una dopo l'altra, ognuna come
+** una pipeline (righe vuote e commenti si saltano). Una sola riga in
+** memoria alla volta, e riga e t_cmdline si riusano fino alla fine.
+**   - builtins: le pipeline passano da picoshell_builtin (cat, grep,
+**     wc... senza processi), altrimenti da picoshell
+**   - stop_on_error: si ferma alla prima pipeline fallita, come sh -e
+**   - path_cache: attiva la cache dei PATH di proc (proc_path_cache),
+**     che resta attiva anche dopo: ogni comando si cerca nel PATH una
+**     volta sola per tutto lo script invece che a ogni lancio
+** Un errore di sintassi si segnala su stderr con il numero di riga e
+** vale come pipeline fallita con codice 2.
+** Ritorna il codice dell'ultima pipeline eseguita (0 se nessuna).
+*/
+int	picoshell_script(FILE *f, const t_script_opts *o)
+{
+	t_cmdline	cl = {0};
+	char		*line = NULL;
+	size_t		cap = 0;
+	size_t		lineno = 0;
+	int			status = 0;
+	int			n;
+
+	if (o && o->path_cache)
+		proc_path_cache(1);
+	while (getline(&line, &cap, f) != -1)
+	{
+		lineno++;
+		n = picoshell_parse(line, &cl);
+		if (n == -1)
+			fprintf(stderr, "picoshell: line %zu: %s\n", lineno, cl.error);
+		if (n == -1)
+			status = 2;
+		else if (n > 0 && o && o->builtins)
+			status = picoshell_builtin(cl.cmds);
+		else if (n > 0)
+			status = picoshell(cl.cmds);
+		if (status && o && o->stop_on_error)
+			break ;
+	}
+	free(line);
+	picoshell_cmdline_free(&cl);
+	return (status);
+}
+
+// int	main(int argc, char **argv)
+// {
+// 	t_script_opts	o = {.path_cache = 1};
+// 	t_cmdline		cl = {0};
+// 	FILE			*f = stdin;
+// 	int				opt;
+// 	int				status;
+
+// 	while ((opt = getopt(argc, argv, "bec:")) != -1)
+// 	{
+// 		if (opt == 'b')
+// 			o.builtins = 1;
+// 		else if (opt == 'e')
+// 			o.stop_on_error = 1;
+// 		else if (opt == 'c')
+// 		{
+// 			if (picoshell_parse(optarg, &cl) == -1)
+// 				return (fprintf(stderr, "picoshell: %s\n", cl.error), 2);
+// 			status = !cl.cmds[0] ? 0 : o.builtins
+// 				? picoshell_builtin(cl.cmds) : picoshell(cl.cmds);
+// 			return (picoshell_cmdline_free(&cl), status);
+// 		}
+// 		else
+// 			return (fprintf(stderr, "usage: %s [-be] [-c line | file]\n",
+// 					argv[0]), 2);
+// 	}
+// 	if (optind < argc && !(f = fopen(argv[optind], "r")))
+// 		return (perror(argv[optind]), 2);
+// 	status = picoshell_script(f, &o);		// ./a.out -b script.txt
+// 	if (f != stdin)
+// 		fclose(f);
+// 	return (status);
+// }
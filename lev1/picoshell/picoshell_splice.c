@@ -0,0 +1,453 @@
+#define _GNU_SOURCE
+#include "picoshell.h"
+#include "../proc/proc.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+/*
+** picoshell_splice: come picoshell(), ma gli stadi non sono collegati
+** direttamente. Ogni stadio scrive in una pipe letta da picoshell e un
+** thread "pompa" per stadio sposta i dati verso lo stadio successivo
+** con splice() (solo riferimenti alle pagine, nessuna copia in user
+** space). In mezzo picoshell può:
+**   - contare i byte prodotti da ogni stadio (bytes[i])
+**   - duplicare con tee() l'uscita di uno stadio verso altri comandi
+**   - ingrandire tutte le pipe con F_SETPIPE_SZ
+**
+**   stadio0 --P0--> [pompa0] --Q0--> stadio1 --P1--> [pompa1] --> stdout
+**                       |
+**                       +--T0--> tee_cmds[0] --> stdout
+**
+** Una pompa per thread: ognuna può bloccarsi sulla propria uscita
+** senza fermare le altre (un solo ciclo bloccante andrebbe in deadlock
+** appena uno stadio riempie la sua pipe mentre si scrive su un'altra).
+** Tutte le pipe sono O_CLOEXEC: i figli tengono solo i fd messi con
+** dup2 su stdin/stdout, niente cicli di close.
+*/
+#define PUMP_CHUNK (1 << 20)
+
+/*
+** Pompa di uno stadio:
+**   - in: lato di lettura della pipe in cui scrive lo stadio
+**   - out[0..nout-1): pipe dei consumatori tee, out[nout-1] l'uscita
+**     principale (stadio successivo o stdout); -1 se chiusa
+**   - sent: byte della porzione corrente già consegnati a ogni uscita
+**   - copy: l'uscita principale non supporta splice (tty, O_APPEND),
+**     si passa a read/write
+*/
+typedef struct s_pump {
+	pthread_t	tid;
+	int			in;
+	int			*out;
+	ssize_t		*sent;
+	int			nout;
+	int			open;
+	int			copy;
+	char		*buf;
+	size_t		bytes;
+	int			err;
+}	t_pump;
+
+static ssize_t	read_n(int fd, char *buf, size_t n)
+{
+	size_t	done = 0;
+
+	while (done < n)
+	{
+		ssize_t	r = read(fd, buf + done, n - done);
+		if (r == -1 && errno == EINTR)
+			continue ;
+		if (r <= 0)
+			return (r == 0 ? (ssize_t)done : -1);
+		done += r;
+	}
+	return (done);
+}
+
+static int	write_all(int fd, const char *buf, size_t n)
+{
+	while (n > 0)
+	{
+		ssize_t	w = write(fd, buf, n);
+		if (w == -1 && errno == EINTR)
+			continue ;
+		if (w == -1)
+			return (-1);
+		buf += w;
+		n -= w;
+	}
+	return (0);
+}
+
+static void	close_out(t_pump *p, int i)
+{
+	close(p->out[i]);
+	p->out[i] = -1;
+	p->open--;
+}
+
+static int	get_buf(t_pump *p)
+{
+	if (!p->buf)
+		p->buf = malloc(PUMP_CHUNK);
+	if (!p->buf)
+		p->err = 1;
+	return (p->buf ? 0 : -1);
+}
+
+/*
+** Ripiego con copia: legge da in i byte [done, n) della porzione
+** corrente e completa ogni uscita aperta a partire da sent[i].
+** Serve quando un tee è stato parziale (pipe del consumatore piena):
+** tee() copia sempre dall'inizio di in, quindi non si può riprendere.
+*/
+static ssize_t	pump_copy(t_pump *p, size_t n, size_t done)
+{
+	if (get_buf(p) || read_n(p->in, p->buf, n - done) != (ssize_t)(n - done))
+		return (p->err = 1, -1);
+	for (int i = 0; i < p->nout; i++)
+	{
+		size_t	from = p->sent[i] > (ssize_t)done ? (size_t)p->sent[i] : done;
+
+		if (p->out[i] != -1 && from < n
+			&& write_all(p->out[i], p->buf + from - done, n - from))
+			close_out(p, i);
+	}
+	return (n);
+}
+
+/*
+** Uscita singola: splice diretto, oppure read/write se l'uscita non
+** lo supporta (EINVAL). EPIPE vuol dire che il lettore è uscito.
+*/
+static ssize_t	pump_move(t_pump *p)
+{
+	int		last = p->nout - 1;
+	ssize_t	n;
+
+	if (p->out[last] == -1)
+		return (0);
+	while (!p->copy)
+	{
+		n = splice(p->in, NULL, p->out[last], NULL, PUMP_CHUNK,
+				SPLICE_F_MOVE);
+		if (n >= 0)
+			return (n);
+		if (errno == EINVAL)
+			p->copy = 1;
+		else if (errno != EINTR)
+			return (errno == EPIPE ? 0 : (p->err = 1, -1));
+	}
+	if (get_buf(p))
+		return (-1);
+	n = read(p->in, p->buf, PUMP_CHUNK);
+	if (n > 0 && write_all(p->out[last], p->buf, n))
+		return (errno == EPIPE ? 0 : (p->err = 1, -1));
+	if (n == -1 && errno == EINTR)
+		return (pump_move(p));
+	return (n == -1 ? (p->err = 1, -1) : n);
+}
+
+/*
+** Dopo i tee, consuma gli n byte della porzione spostandoli
+** sull'uscita principale. Se splice non va più, il resto passa da
+** pump_copy (i tee a quel punto sono già tutti completi).
+*/
+static ssize_t	pump_splice(t_pump *p, size_t n)
+{
+	int		last = p->nout - 1;
+	size_t	done = 0;
+
+	while (done < n && !p->copy)
+	{
+		ssize_t	s = splice(p->in, NULL, p->out[last], NULL, n - done,
+				SPLICE_F_MOVE);
+		if (s > 0)
+			done += s;
+		else if (s == -1 && errno == EINVAL)
+			p->copy = 1;
+		else if (s == -1 && errno == EPIPE)
+			break ;
+		else if (s == 0 || errno != EINTR)
+			return (p->err = 1, -1);
+	}
+	if (done == n)
+		return (n);
+	p->sent[last] = done;
+	if (!p->copy)
+		close_out(p, last);
+	return (pump_copy(p, n, done));
+}
+
+/*
+** Un passo della pompa: la prima uscita tee aperta decide quanti byte
+** compongono la porzione (n), le altre ricevono gli stessi n byte; poi
+** la porzione viene consumata verso l'uscita principale.
+** Ritorna i byte spostati, 0 a fine input, -1 in caso di errore.
+*/
+static ssize_t	pump_step(t_pump *p)
+{
+	int		last = p->nout - 1;
+	ssize_t	n = 0;
+	int		partial = 0;
+
+	for (int i = 0; i < last; i++)
+	{
+		if (p->out[i] == -1)
+			continue ;
+		do
+			p->sent[i] = tee(p->in, p->out[i], n ? (size_t)n : PUMP_CHUNK, 0);
+		while (p->sent[i] == -1 && errno == EINTR);
+		if (p->sent[i] == -1)
+		{
+			close_out(p, i);
+			continue ;
+		}
+		if (n == 0 && p->sent[i] == 0)
+			return (0);
+		if (n == 0)
+			n = p->sent[i];
+		partial |= p->sent[i] < n;
+	}
+	if (n == 0)
+		return (pump_move(p));
+	p->sent[last] = 0;
+	if (!partial && !p->copy && p->out[last] != -1)
+		return (pump_splice(p, n));
+	return (pump_copy(p, n, 0));
+}
+
+static void	*pump_run(void *arg)
+{
+	t_pump	*p = arg;
+	ssize_t	n;
+
+	while (p->open > 0 && (n = pump_step(p)) > 0)
+		p->bytes += n;
+	for (int i = 0; i < p->nout; i++)
+		if (p->out[i] != -1)
+			close_out(p, i);
+	close(p->in);
+	p->in = -1;
+	free(p->buf);
+	return (NULL);
+}
+
+/*
+** Stato di una esecuzione: nproc = stadi + consumatori tee; per ogni
+** processo in/out sono i fd da mettere su stdin/stdout (-1 = ereditato)
+** e proc il figlio lanciato (proc/proc.h).
+*/
+typedef struct s_run {
+	int		nstage;
+	int		nproc;
+	t_pump	*pump;
+	int		*in;
+	int		*out;
+	t_proc	*proc;
+}	t_run;
+
+static void	close_fd(int *fd)
+{
+	if (*fd != -1)
+		close(*fd);
+	*fd = -1;
+}
+
+static void	run_free(t_run *r)
+{
+	for (int i = 0; r->in && i < r->nproc; i++)
+	{
+		close_fd(&r->in[i]);
+		close_fd(&r->out[i]);
+	}
+	for (int i = 0; r->pump && i < r->nstage; i++)
+	{
+		close_fd(&r->pump[i].in);
+		for (int j = 0; j < r->pump[i].nout; j++)
+			close_fd(&r->pump[i].out[j]);
+		free(r->pump[i].out);
+		free(r->pump[i].sent);
+	}
+	free(r->pump);
+	free(r->in);
+	r->pump = NULL;
+	r->in = NULL;
+}
+
+/*
+** Alloca tutto e crea tutte le pipe prima di lanciare qualunque
+** processo, così un errore qui non lascia figli appesi.
+*/
+static int	run_setup(t_run *r, const t_splice_opts *o, int ntee)
+{
+	int	fd[2];
+
+	r->pump = calloc(r->nstage, sizeof(*r->pump));
+	r->in = malloc(2 * r->nproc * sizeof(*r->in));
+	r->proc = malloc(r->nproc * sizeof(*r->proc));
+	if (!r->pump || !r->in || !r->proc)
+		return (-1);
+	r->out = r->in + r->nproc;
+	for (int i = 0; i < 2 * r->nproc; i++)
+		r->in[i] = -1;
+	for (int i = 0; i < r->nstage; i++)
+	{
+		t_pump	*p = &r->pump[i];
+
+		p->in = -1;
+		p->nout = 1 + (i == o->tee_stage ? ntee : 0);
+		p->open = p->nout;
+		p->out = malloc(p->nout * sizeof(*p->out));
+		p->sent = calloc(p->nout, sizeof(*p->sent));
+		if (!p->out || !p->sent)
+			return (p->nout = 0, -1);
+		for (int j = 0; j < p->nout; j++)
+			p->out[j] = -1;
+		if (proc_pipe(fd, o->pipe_size))
+			return (-1);
+		r->out[i] = fd[1];
+		p->in = fd[0];
+		for (int j = 0; j < p->nout - 1; j++)
+		{
+			if (proc_pipe(fd, o->pipe_size))
+				return (-1);
+			r->in[r->nstage + j] = fd[0];
+			p->out[j] = fd[1];
+		}
+		if (i + 1 < r->nstage && proc_pipe(fd, o->pipe_size))
+			return (-1);
+		if (i + 1 < r->nstage)
+			r->in[i + 1] = fd[0];
+		p->out[p->nout - 1] = i + 1 < r->nstage ? fd[1]
+			: fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+		if (p->out[p->nout - 1] == -1)
+			return (-1);
+	}
+	return (0);
+}
+
+/*
+** pico_spawn: proc_spawn con solo stdin/stdout (-1 = fd ereditato),
+** per chi tiene i figli come semplici pid.
+*/
+pid_t	pico_spawn(char **argv, int in, int out)
+{
+	t_proc	p;
+
+	proc_spawn(&p, argv[0], argv, (int [3]){in, out, -1});
+	return (p.pid);
+}
+
+/*
+** Lancia i processi e le pompe. I fd passati ai figli vengono chiusi
+** nel padre subito dopo il lancio; quelli delle pompe li chiude il thread
+** a fine lavoro. SIGPIPE è bloccato mentre si creano i thread, così le
+** pompe lo ereditano bloccato e un lettore uscito diventa solo EPIPE.
+** Un processo che non parte (pid -1) mette *err a 1 ma non ferma gli
+** altri, come in picoshell: chiusi i suoi fd, la pompa che lo alimenta
+** riceve EPIPE e quella che legge la sua uscita vede subito EOF.
+*/
+static void	run_start(t_run *r, char **cmds[], char ***tee_cmds, int *err)
+{
+	sigset_t	set;
+	sigset_t	old;
+
+	for (int n = 0; n < r->nproc; n++)
+	{
+		char	**argv = n < r->nstage ? cmds[n] : tee_cmds[n - r->nstage];
+
+		if (proc_spawn(&r->proc[n], argv[0], argv,
+				(int [3]){r->in[n], r->out[n], -1}) == -1)
+			*err = 1;
+		close_fd(&r->in[n]);
+		close_fd(&r->out[n]);
+	}
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	for (int i = 0; i < r->nstage; i++)
+	{
+		if (pthread_create(&r->pump[i].tid, NULL, pump_run, &r->pump[i]))
+		{
+			*err = 1;
+			r->pump[i].tid = pthread_self();
+			close_fd(&r->pump[i].in);
+			for (int j = 0; j < r->pump[i].nout; j++)
+				close_fd(&r->pump[i].out[j]);
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/*
+** bytes, se non NULL, riceve per ogni stadio i byte scritti sul suo
+** stdout (0 per uno stadio non partito, tutti 0 se non parte nulla).
+** Ritorna 1 se uno stadio esce con codice != 0 o se qualcosa
+** fallisce, altrimenti 0 (come picoshell).
+*/
+int	picoshell_splice(char **cmds[], const t_splice_opts *opts,
+		size_t *bytes)
+{
+	t_splice_opts	o = {.tee_stage = -1};
+	t_run			r = {0};
+	int				ntee = 0;
+	int				err = 0;
+
+	if (opts)
+		o = *opts;
+	while (cmds[r.nstage])
+		r.nstage++;
+	for (int i = 0; bytes && i < r.nstage; i++)
+		bytes[i] = 0;
+	while (o.tee_cmds && o.tee_stage >= 0 && o.tee_stage < r.nstage
+		&& o.tee_cmds[ntee])
+		ntee++;
+	r.nproc = r.nstage + ntee;
+	if (r.nstage == 0 || run_setup(&r, &o, ntee))
+		return (run_free(&r), free(r.proc), 1);
+	run_start(&r, cmds, o.tee_cmds, &err);
+	proc_wait_all(r.proc, r.nproc);
+	for (int i = 0; i < r.nproc; i++)
+		if (proc_wait(&r.proc[i], 0) == -1
+			|| (WIFEXITED(r.proc[i].status)
+				&& WEXITSTATUS(r.proc[i].status) != 0))
+			err = 1;
+	for (int i = 0; i < r.nstage; i++)
+	{
+		if (!pthread_equal(r.pump[i].tid, pthread_self()))
+			pthread_join(r.pump[i].tid, NULL);
+		err |= r.pump[i].err;
+		if (bytes)
+			bytes[i] = r.pump[i].bytes;
+	}
+	run_free(&r);
+	free(r.proc);
+	return (err);
+}
+
+// int	main(void)
+// {
+// 	char			*gen[] = {"seq", "1", "1000000", NULL};
+// 	char			*grep[] = {"grep", "7", NULL};
+// 	char			*wc[] = {"wc", "-l", NULL};
+// 	char			*tail[] = {"tail", "-n", "1", NULL};
+// 	char			**cmds[] = {gen, grep, wc, NULL};
+// 	char			**tee[] = {tail, NULL};
+// 	t_splice_opts	opts = {.pipe_size = 1 << 20, .tee_stage = 1,
+// 		.tee_cmds = tee};
+// 	size_t			bytes[3];
+// 	int				res;
+
+// 	res = picoshell_splice(cmds, &opts, bytes);	// 468559 e 999997
+// 	printf("Result: %d\n", res);
+// 	for (int i = 0; i < 3; i++)
+// 		printf("stage %d: %zu bytes\n", i, bytes[i]);
+// 	return (0);
+// }
@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+#include "proc.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+extern char	**environ;
+
+/*
+** Regole comuni:
+**   - ogni pipe nasce O_CLOEXEC: nessun figlio eredita per sbaglio il
+**     lato di scrittura di un altro (toglierebbe l'EOF), e al figlio
+**     bastano i dup2 sui fd 0/1/2, niente lista di close
+**   - io[3]: fd da mettere su stdin/stdout/stderr del figlio, -1 (o io
+**     NULL) per ereditare quello del padre
+**   - i figli si lanciano con posix_spawnp (vfork + exec, il costo non
+**     cresce con la memoria del padre) e ripartono con SIGCHLD e SIGPIPE
+**     al default e nessun segnale bloccato, qualunque cosa abbia fatto
+**     il thread che li lancia
+**   - si attende sempre per pid con wait4, mai wait(): gli altri figli
+**     del chiamante non vengono toccati, e le risorse si misurano
+*/
+
+/*
+** proc_pipe: pipe2 O_CLOEXEC; size > 0 chiede quella capacità con
+** F_SETPIPE_SZ (se il kernel rifiuta resta quella di default).
+** Ritorna 0, -1 in caso di errore.
+*/
+int	proc_pipe(int fd[2], size_t size)
+{
+	if (pipe2(fd, O_CLOEXEC) == -1)
+		return (-1);
+	if (size)
+		fcntl(fd[1], F_SETPIPE_SZ, (int)size);
+	return (0);
+}
+
+static void	proc_init(t_proc *p)
+{
+	*p = (t_proc){.pid = -1, .pidfd = -1};
+	clock_gettime(CLOCK_MONOTONIC, &p->start);
+}
+
+/*
+** Cache dei PATH (proc_path_cache): posix_spawnp, come execvp, prova
+** l'exec in ogni directory del PATH a ogni lancio. Con la cache attiva
+** il primo lancio di un nome cerca il file una volta (access X_OK) e
+** ricorda il percorso; i lanci successivi usano posix_spawn diretto.
+**   - tabella a indirizzamento aperto, hash FNV-1a, capacità potenza
+**     di due, cresce oltre metà piena
+**   - si svuota da sola se PATH cambia
+**   - un percorso che non funziona più (file rimosso) viene dimenticato
+**     e il lancio riprova con posix_spawnp
+**   - i nomi non trovati non vengono ricordati
+** Un mutex la protegge: si lancia anche da più thread.
+*/
+typedef struct s_path_entry {
+	char	*name;
+	char	*path;
+}	t_path_entry;
+
+static struct {
+	pthread_mutex_t	lock;
+	int				on;
+	char			*env;
+	t_path_entry	*tab;
+	size_t			cap;
+	size_t			len;
+}	g_paths = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void	cache_clear(void)
+{
+	for (size_t i = 0; i < g_paths.cap; i++)
+	{
+		free(g_paths.tab[i].name);
+		free(g_paths.tab[i].path);
+	}
+	free(g_paths.tab);
+	free(g_paths.env);
+	g_paths.tab = NULL;
+	g_paths.env = NULL;
+	g_paths.cap = 0;
+	g_paths.len = 0;
+}
+
+/*
+** proc_path_cache: attiva (1) o disattiva e svuota (0) la cache.
+*/
+void	proc_path_cache(int enable)
+{
+	pthread_mutex_lock(&g_paths.lock);
+	if (!enable)
+		cache_clear();
+	g_paths.on = enable;
+	pthread_mutex_unlock(&g_paths.lock);
+}
+
+static size_t	cache_slot(t_path_entry *tab, size_t cap, const char *name)
+{
+	size_t	h = 14695981039346656037UL;
+
+	for (const char *s = name; *s; s++)
+		h = (h ^ (unsigned char)*s) * 1099511628211UL;
+	h &= cap - 1;
+	while (tab[h].name && strcmp(tab[h].name, name))
+		h = (h + 1) & (cap - 1);
+	return (h);
+}
+
+static int	cache_grow(void)
+{
+	size_t			cap = g_paths.cap ? g_paths.cap * 2 : 64;
+	t_path_entry	*tab = calloc(cap, sizeof(*tab));
+
+	if (!tab)
+		return (-1);
+	for (size_t i = 0; i < g_paths.cap; i++)
+		if (g_paths.tab[i].name)
+			tab[cache_slot(tab, cap, g_paths.tab[i].name)] = g_paths.tab[i];
+	free(g_paths.tab);
+	g_paths.tab = tab;
+	g_paths.cap = cap;
+	return (0);
+}
+
+/*
+** Cerca name nelle directory di env (una voce vuota è la directory
+** corrente). Ritorna 0 con il percorso in out, -1 se non c'è.
+*/
+static int	search_path(const char *env, const char *name, char *out)
+{
+	struct stat	sb;
+	size_t		len;
+
+	while (env)
+	{
+		const char	*end = strchr(env, ':');
+
+		len = end ? (size_t)(end - env) : strlen(env);
+		if (len + strlen(name) + 2 <= PATH_MAX)
+		{
+			memcpy(out, len ? env : ".", len ? len : 1);
+			out[len ? len : 1] = '/';
+			strcpy(out + (len ? len : 1) + 1, name);
+			if (access(out, X_OK) == 0 && stat(out, &sb) == 0
+				&& S_ISREG(sb.st_mode))
+				return (0);
+		}
+		env = end ? end + 1 : NULL;
+	}
+	return (-1);
+}
+
+/*
+** Percorso di file secondo la cache, copiato in out. Ritorna 0, -1 se
+** la cache è spenta, il nome contiene '/' o non è stato trovato.
+*/
+static int	cache_lookup(const char *file, char *out)
+{
+	const char	*env = getenv("PATH");
+	size_t		h;
+	int			ret = -1;
+
+	if (!env || strchr(file, '/'))
+		return (-1);
+	pthread_mutex_lock(&g_paths.lock);
+	if (g_paths.on && g_paths.env && strcmp(g_paths.env, env))
+		cache_clear();
+	if (g_paths.on && !g_paths.env)
+		g_paths.env = strdup(env);
+	if (g_paths.on && g_paths.env)
+	{
+		h = g_paths.cap ? cache_slot(g_paths.tab, g_paths.cap, file) : 0;
+		if (g_paths.cap && g_paths.tab[h].name)
+			ret = (strcpy(out, g_paths.tab[h].path), 0);
+		else if (search_path(env, file, out) == 0)
+		{
+			ret = 0;
+			if ((2 * (g_paths.len + 1) <= g_paths.cap || cache_grow() == 0))
+			{
+				h = cache_slot(g_paths.tab, g_paths.cap, file);
+				g_paths.tab[h] = (t_path_entry){strdup(file), strdup(out)};
+				if (!g_paths.tab[h].name || !g_paths.tab[h].path)
+				{
+					free(g_paths.tab[h].name);
+					free(g_paths.tab[h].path);
+					g_paths.tab[h] = (t_path_entry){0};
+				}
+				else
+					g_paths.len++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&g_paths.lock);
+	return (ret);
+}
+
+/*
+** Dimentica file: con l'indirizzamento aperto non si può solo svuotare
+** la casella, si ricostruisce la tabella senza di lui.
+*/
+static void	cache_forget(const char *file)
+{
+	t_path_entry	*old;
+	size_t			cap;
+	size_t			h;
+
+	pthread_mutex_lock(&g_paths.lock);
+	h = g_paths.cap ? cache_slot(g_paths.tab, g_paths.cap, file) : 0;
+	if (g_paths.cap && g_paths.tab[h].name)
+	{
+		free(g_paths.tab[h].name);
+		free(g_paths.tab[h].path);
+		g_paths.tab[h] = (t_path_entry){0};
+		g_paths.len--;
+		old = g_paths.tab;
+		cap = g_paths.cap;
+		g_paths.tab = calloc(cap, sizeof(*old));
+		if (g_paths.tab)
+			for (size_t i = 0; i < cap; i++)
+				if (old[i].name)
+					g_paths.tab[cache_slot(g_paths.tab, cap, old[i].name)] = old[i];
+		if (!g_paths.tab)
+		{
+			g_paths.tab = old;
+			cache_clear();
+		}
+		else
+			free(old);
+	}
+	pthread_mutex_unlock(&g_paths.lock);
+}
+
+/*
+** proc_spawn: lancia file (cercato nel PATH come execvp, o nella cache
+** se attiva) con argv. Ritorna 0, -1 con errno impostato se il lancio
+** fallisce (anche per comando inesistente); in quel caso p->pid vale -1.
+*/
+int	proc_spawn(t_proc *p, const char *file, char *const argv[],
+		const int io[3])
+{
+	posix_spawn_file_actions_t	fa;
+	posix_spawnattr_t			attr;
+	sigset_t					set;
+	char						path[PATH_MAX];
+	int							err;
+
+	proc_init(p);
+	if (posix_spawn_file_actions_init(&fa) != 0)
+		return (-1);
+	if (posix_spawnattr_init(&attr) != 0)
+		return (posix_spawn_file_actions_destroy(&fa), -1);
+	for (int i = 0; io && i < 3; i++)
+		if (io[i] != -1)
+			posix_spawn_file_actions_adddup2(&fa, io[i], i);
+	sigemptyset(&set);
+	posix_spawnattr_setsigmask(&attr, &set);
+	sigaddset(&set, SIGCHLD);
+	sigaddset(&set, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &set);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+		| POSIX_SPAWN_SETSIGDEF);
+	err = -1;
+	if (cache_lookup(file, path) == 0)
+	{
+		err = posix_spawn(&p->pid, path, &fa, &attr, argv, environ);
+		if (err)
+			cache_forget(file);
+	}
+	if (err)
+		err = posix_spawnp(&p->pid, file, &fa, &attr, argv, environ);
+	posix_spawn_file_actions_destroy(&fa);
+	posix_spawnattr_destroy(&attr);
+	if (err)
+		p->pid = -1;
+	return (err ? (errno = err, -1) : 0);
+}
+
+/*
+** proc_fork: come fork(), per chi deve eseguire codice proprio nel
+** figlio (sandbox). Nel figlio fa i dup2 di io e ritorna 0; nel padre
+** ritorna il pid (-1 se fork fallisce).
+*/
+pid_t	proc_fork(t_proc *p, const int io[3])
+{
+	proc_init(p);
+	p->pid = fork();
+	if (p->pid != 0)
+		return (p->pid);
+	for (int i = 0; io && i < 3; i++)
+		if (io[i] != -1 && dup2(io[i], i) == -1)
+			_exit(127);
+	return (0);
+}
+
+/*
+** proc_pidfd: apre (una volta sola) il pidfd del figlio e lo ritorna;
+** -1 se il figlio non c'è o il kernel non lo supporta. Il pidfd è
+** O_CLOEXEC e lo chiude proc_wait quando raccoglie il figlio.
+*/
+int	proc_pidfd(t_proc *p)
+{
+	if (p->pidfd == -1 && p->pid > 0 && !p->reaped)
+		p->pidfd = (int)syscall(SYS_pidfd_open, p->pid, 0);
+	return (p->pidfd);
+}
+
+static long long	tv_us(struct timeval tv)
+{
+	return (tv.tv_sec * 1000000LL + tv.tv_usec);
+}
+
+/*
+** proc_wait: raccoglie il figlio con wait4 (options come waitpid, di
+** solito 0 o WNOHANG) e ne riempie le misure.
+** Ritorna 1 se è stato raccolto (anche prima), 0 se con WNOHANG è
+** ancora vivo, -1 se non c'è o wait4 fallisce (status vale -1).
+*/
+int	proc_wait(t_proc *p, int options)
+{
+	struct rusage	ru;
+	struct timespec	now;
+	pid_t			r;
+
+	if (p->reaped)
+		return (p->status == -1 ? -1 : 1);
+	if (p->pid <= 0)
+		return (-1);
+	do
+		r = wait4(p->pid, &p->status, options, &ru);
+	while (r == -1 && errno == EINTR);
+	if (r == 0)
+		return (0);
+	p->reaped = 1;
+	if (p->pidfd != -1)
+		close(p->pidfd);
+	p->pidfd = -1;
+	if (r == -1)
+		return (p->status = -1, -1);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	p->wall_us = (now.tv_sec - p->start.tv_sec) * 1000000LL
+		+ (now.tv_nsec - p->start.tv_nsec) / 1000;
+	p->user_us = tv_us(ru.ru_utime);
+	p->sys_us = tv_us(ru.ru_stime);
+	p->maxrss_kb = ru.ru_maxrss;
+	p->minflt = ru.ru_minflt;
+	p->majflt = ru.ru_majflt;
+	return (1);
+}
+
+/*
+** proc_wait_all: raccoglie tutti i figli di ps, ognuno appena termina
+** (un poll() sui pidfd), così wall_us non include l'attesa degli altri.
+** Quelli senza pidfd (kernel < 5.3 o malloc fallita) si attendono alla
+** fine, in ordine.
+*/
+void	proc_wait_all(t_proc *ps, size_t n)
+{
+	struct pollfd	*pfd = malloc((n ? n : 1) * sizeof(*pfd));
+	size_t			left = 0;
+
+	for (size_t i = 0; pfd && i < n; i++)
+	{
+		pfd[i] = (struct pollfd){.events = POLLIN,
+			.fd = ps[i].reaped ? -1 : proc_pidfd(&ps[i])};
+		left += pfd[i].fd != -1;
+	}
+	while (left > 0)
+	{
+		if (poll(pfd, n, -1) == -1 && errno != EINTR)
+			break ;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (pfd[i].fd == -1 || !pfd[i].revents)
+				continue ;
+			pfd[i].fd = -1;
+			proc_wait(&ps[i], 0);
+			left--;
+		}
+	}
+	for (size_t i = 0; i < n; i++)
+		proc_wait(&ps[i], 0);
+	free(pfd);
+}
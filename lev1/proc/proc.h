@@ -0,0 +1,44 @@
+#ifndef PROC_H
+#define PROC_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+/*
+** Nucleo comune di picoshell, ft_popen e sandbox: pipe, lancio e attesa
+** dei figli in un posto solo.
+**
+** Figlio lanciato da proc_spawn o proc_fork:
+**   - pid: -1 se il lancio è fallito
+**   - pidfd: leggibile quando il figlio termina; lo apre proc_pidfd
+**     (-1 se non aperto o se il kernel non supporta pidfd_open)
+**   - status/reaped: stato di wait4, valido quando reaped != 0
+**   - start: istante del lancio (CLOCK_MONOTONIC)
+**   - wall_us: dal lancio alla raccolta; user_us, sys_us, maxrss_kb,
+**     minflt, majflt: da struct rusage. Validi quando reaped != 0
+*/
+typedef struct s_proc {
+	pid_t			pid;
+	int				pidfd;
+	int				status;
+	int				reaped;
+	struct timespec	start;
+	long long		wall_us;
+	long long		user_us;
+	long long		sys_us;
+	long			maxrss_kb;
+	long			minflt;
+	long			majflt;
+}	t_proc;
+
+int		proc_pipe(int fd[2], size_t size);
+int		proc_spawn(t_proc *p, const char *file, char *const argv[],
+			const int io[3]);
+pid_t	proc_fork(t_proc *p, const int io[3]);
+int		proc_pidfd(t_proc *p);
+int		proc_wait(t_proc *p, int options);
+void	proc_wait_all(t_proc *ps, size_t n);
+void	proc_path_cache(int enable);
+
+#endif
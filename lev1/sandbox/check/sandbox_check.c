@@ -0,0 +1,114 @@
+/*
+** sandbox_check: controlla che sandbox_batch ritorni (senza bloccarsi)
+** quando i figli non possono partire.
+**
+** Compilazione:
+**   cc -O2 -I.. sandbox_check.c ../sandbox.c ../sandbox_batch.c \
+**       ../sandbox_fsrv.c ../../proc/proc.c -o sandbox_check
+**
+** Uso:
+**   ./sandbox_check
+**
+** Casi, ognuno in un processo figlio con un alarm() di guardia (se la
+** chiamata si blocca SIGALRM uccide il figlio e il caso fallisce):
+**   - fd esauriti: RLIMIT_NOFILE abbassato al minimo e cattura attiva,
+**     le pipe di cattura non si creano; sandbox_batch deve ritornare 0
+**     con tutti i risultati a -1
+**   - fork impossibile: RLIMIT_NPROC a 0 (da root prima si passa
+**     all'utente nobody, per root il limite non vale); sandbox() e
+**     sandbox_ms() devono ritornare -1 come quando fork fallisce nella
+**     versione con alarm()
+** Stampa una riga per caso ed esce con 1 se almeno un caso fallisce.
+*/
+#include "sandbox.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <grp.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define GUARD_SEC 5
+#define NJOBS 4
+#define NOBODY 65534
+
+static void	nice_ft(void)
+{
+}
+
+/*
+** RLIMIT_NOFILE = fd più alto aperto + 1: non si può aprire più nulla.
+*/
+static int	exhaust_fds(void)
+{
+	int				top = dup(STDERR_FILENO);
+	struct rlimit	rl;
+
+	if (top == -1)
+		return (-1);
+	rl.rlim_cur = top + 1;
+	rl.rlim_max = top + 1;
+	return (setrlimit(RLIMIT_NOFILE, &rl));
+}
+
+static int	case_no_fds(void)
+{
+	void			(*fs[NJOBS])(void) = {nice_ft, nice_ft, nice_ft, nice_ft};
+	t_sbx_result	res[NJOBS];
+	t_sbx_opts		o = {.parallel = 2, .capture = 4096};
+
+	if (exhaust_fds() == -1)
+		return (1);
+	if (sandbox_batch(fs, NJOBS, &o, res) != 0)
+		return (1);
+	for (int i = 0; i < NJOBS; i++)
+		if (res[i].res != -1)
+			return (1);
+	return (0);
+}
+
+static int	case_no_fork(void)
+{
+	struct rlimit	rl = {0, 0};
+
+	if (getuid() == 0 && (setgroups(0, NULL) == -1
+			|| setgid(NOBODY) == -1 || setuid(NOBODY) == -1))
+		return (1);
+	if (setrlimit(RLIMIT_NPROC, &rl) == -1)
+		return (1);
+	return (sandbox(nice_ft, 1, false) != -1
+		|| sandbox_ms(nice_ft, 0, true) != -1);
+}
+
+/*
+** Esegue c in un figlio con alarm(GUARD_SEC): 0 solo se il figlio esce
+** da solo con 0.
+*/
+static int	run_case(const char *name, int (*c)(void))
+{
+	pid_t	pid;
+	int		status;
+	int		ok;
+
+	fflush(NULL);
+	pid = fork();
+	if (pid == 0)
+	{
+		alarm(GUARD_SEC);
+		exit(c());
+	}
+	ok = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status)
+		&& WEXITSTATUS(status) == 0;
+	printf("%-4s %s%s\n", ok ? "ok" : "FAIL", name,
+		pid > 0 && WIFSIGNALED(status) ? " (blocked)" : "");
+	return (!ok);
+}
+
+int	main(void)
+{
+	int	ret = 0;
+
+	ret |= run_case("sandbox_batch with no free fds", case_no_fds);
+	ret |= run_case("sandbox with fork failing", case_no_fork);
+	return (ret);
+}
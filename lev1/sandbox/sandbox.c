@@ -7,85 +7,54 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <string.h>
+#include <limits.h>
+#include "sandbox.h"
 
 /*    Flusso logico:
 - Verifica che il puntatore alla funzione non sia NULL.
-- Imposta il gestore per SIGALRM tramite struct sigaction.
-- Esegue fork() per creare un processo figlio.
-- Nel processo figlio:
-* Esegue la funzione f().
-* Termina con exit(0).
-- Nel processo padre:
-* Se timeout > 0, imposta un allarme con alarm(timeout).
-		* Attende il figlio con waitpid(pid, &status, 0).
-	- Se waitpid è interrotto da un segnale (errno == EINTR):
+- Esegue la funzione con sandbox_batch (un solo job), che:
+* Esegue fork() per creare un processo figlio.
+* Nel processo figlio: esegue la funzione f() e termina con exit(0).
+* Nel processo padre: attende il figlio con poll() sul suo pidfd, con
+  timeout in millisecondi (0 = nessun limite).
+	- Niente alarm() né gestore di SIGALRM: lo stato dei segnali del
+	  processo resta quello del chiamante e più sandbox possono girare
+	  insieme (anche da thread diversi).
+	- Allo scadere del timeout:
 		* Uccide il figlio con SIGKILL.
 		* Attende la sua terminazione.
-		* Disattiva l’allarme.
 		* Se verbose, stampa un messaggio di timeout.
 		* Ritorna 0.
-		- Se waitpid fallisce per altri motivi, disattiva l’allarme e ritorna -1.
-		- Disattiva l’allarme una volta completata l’attesa.
 		- Se il figlio termina normalmente (WIFEXITED):
 		* Se WEXITSTATUS == 0:
 		stampa "Nice function!" se verbose e ritorna 1.
 		* Altrimenti:
 		stampa il codice di uscita e ritorna 0.
 		- Se il figlio termina per un segnale (WIFSIGNALED):
-		* Ottiene il numero del segnale con WTERMSIG.
 		* Stampa il nome del segnale (strsignal(sig)) se verbose.
 		* Ritorna 0.
-		- Ritorna -1 in caso di stato non previsto.
+		- Ritorna -1 in caso di errore (fork fallita o stato non previsto).
+- sandbox() è sandbox_ms() con il timeout in secondi: la conversione
+  si fa a 64 bit e satura a UINT_MAX ms (circa 49 giorni), invece di
+  riavvolgersi oltre 4294967 secondi.
 		*/
 
-void alarm_handler(int sig) {
-	(void)sig;
+int	sandbox_ms(void (*f)(void), unsigned int timeout_ms, bool verbose)
+{
+	t_sbx_opts		opts = {.timeout_ms = timeout_ms, .parallel = 1,
+		.verbose = verbose};
+	t_sbx_result	res;
+
+	if (!f) return (-1);
+	if (sandbox_batch(&f, 1, &opts, &res) == -1) return (-1);
+	return (res.res);
 }
+
 int	sandbox(void (*f)(void), unsigned int timeout, bool verbose)
 {
-	struct sigaction	sa;
-	pid_t				pid;
-	int					status;
+	unsigned long long	ms = timeout * 1000ULL;
 
-	if (!f) return (-1);
-	sa.sa_handler = alarm_handler;
-	sa.sa_flags = 0;
-	sigemptyset(&sa.sa_mask);
-	sigaction(SIGALRM, &sa, NULL);
-	pid = fork();
-	if (pid == -1) return (-1);
-	if (pid == 0) {
-		f();
-		exit(0);
-	}
-	if (timeout > 0) alarm(timeout);
-	if (waitpid(pid, &status, 0) == -1) {
-		if (errno == EINTR) {
-			kill(pid, SIGKILL);
-			waitpid(pid, NULL, 0);
-			alarm(0);
-			if (verbose) printf("Bad function: timed out after %u seconds\n", timeout);
-			return (0);
-		}
-		alarm(0);
-		return (-1);
-	}
-	alarm(0);
-	if (WIFEXITED(status)){
-		if (WEXITSTATUS(status) == 0) {
-			if (verbose) printf("Nice function!\n");
-			return (1);
-		} else {
-			if (verbose) printf("Bad function: exited with code %d\n", WEXITSTATUS(status));
-			return (0);
-		}
-	}
-	if (WIFSIGNALED(status)){
-		int	sig = WTERMSIG(status);
-		if (verbose) printf("Bad function: %s\n", strsignal(sig));
-		return (0);
-	}
-	return (-1);
+	return (sandbox_ms(f, ms > UINT_MAX ? UINT_MAX : ms, verbose));
 }
 
  //TESTING
@@ -130,4 +99,6 @@ int	sandbox(void (*f)(void), unsigned int timeout, bool verbose)
 // 	printf("res is %d\n", res);
 // 	res = sandbox(bad_ft_sigkill, 2, true);
 // 	printf("res is %d\n", res);
+// 	res = sandbox_ms(bad_ft_timeout, 50, true);	// timed out after 50 ms
+// 	printf("res is %d\n", res);
 // }
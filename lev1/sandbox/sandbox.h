@@ -0,0 +1,85 @@
+#ifndef SANDBOX_H
+#define SANDBOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "../proc/proc.h"
+
+/*
+** Opzioni di sandbox_batch:
+**   - timeout_ms: millisecondi per ogni funzione, 0 = nessun limite
+**   - parallel: figli contemporanei, <= 0 per uno per CPU
+**   - verbose: stampa l'esito di ogni funzione (a fine batch, in
+**     ordine, con gli stessi messaggi di sandbox)
+**   - cpu_sec, as_bytes, nofile: limiti setrlimit del figlio (CPU,
+**     spazio di indirizzi, file aperti), 0 = nessun limite
+**   - capture: se > 0, stdout e stderr del figlio finiscono nei buffer
+**     del risultato invece che sullo stdout del chiamante, al più
+**     capture byte per flusso
+*/
+typedef struct s_sbx_opts {
+	unsigned int	timeout_ms;
+	int				parallel;
+	bool			verbose;
+	unsigned int	cpu_sec;
+	size_t			as_bytes;
+	unsigned int	nofile;
+	size_t			capture;
+}	t_sbx_opts;
+
+/*
+** Esito di una funzione:
+**   - res: 1 nice, 0 bad, -1 errore (come il ritorno di sandbox)
+**   - status: stato di wait4
+**   - timed_out: ucciso allo scadere del timeout
+**   - user_us, sys_us, maxrss_kb, minflt, majflt: misure di wait4
+**   - out, err: uscite catturate (terminate da '\0', NULL se vuote),
+**     out_len, err_len le loro lunghezze; truncated se almeno uno dei
+**     due ha superato capture. Da liberare con sandbox_free
+*/
+typedef struct s_sbx_result {
+	int			res;
+	int			status;
+	bool		timed_out;
+	long long	user_us;
+	long long	sys_us;
+	long		maxrss_kb;
+	long		minflt;
+	long		majflt;
+	char		*out;
+	size_t		out_len;
+	char		*err;
+	size_t		err_len;
+	bool		truncated;
+}	t_sbx_result;
+
+int	sandbox(void (*f)(void), unsigned int timeout, bool verbose);
+int	sandbox_ms(void (*f)(void), unsigned int timeout_ms, bool verbose);
+int	sandbox_batch(void (**fs)(void), size_t n, const t_sbx_opts *opts,
+		t_sbx_result *res);
+void	sandbox_free(t_sbx_result *res, size_t n);
+
+/*
+** Fork server (sandbox_fsrv.c): processo creato una volta da
+** fsrv_start, che per ogni fsrv_run fa fork di se stesso ed esegue la
+** funzione. proc è il server stesso (creato con proc_fork, raccolto da
+** fsrv_stop), sock è il socket verso di lui.
+*/
+typedef struct s_fsrv {
+	t_proc	proc;
+	int		sock;
+}	t_fsrv;
+
+int		fsrv_start(t_fsrv *s, void (*init)(void));
+int		fsrv_run(t_fsrv *s, void (*f)(void), const t_sbx_opts *opts,
+			t_sbx_result *r);
+void	fsrv_stop(t_fsrv *s);
+
+/*UTILS*/
+void	sbx_classify(t_sbx_result *r);
+void	sbx_report(const t_sbx_result *r, unsigned int timeout_ms);
+void	sbx_apply_limits(const t_sbx_opts *o);
+void	sbx_account(t_sbx_result *r, const t_proc *p);
+
+#endif
@@ -0,0 +1,413 @@
+#define _GNU_SOURCE
+#include "sandbox.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*
+** sandbox_batch: esegue n funzioni, ognuna in un figlio come sandbox(),
+** ma fino a parallel figli alla volta. Il tempo totale diventa circa
+** somma / parallel invece della somma.
+**
+** Niente alarm(): è unico per processo, ha la risoluzione del secondo
+** e vuole un gestore di SIGALRM globale. Ogni figlio ha un pidfd
+** (leggibile quando termina) e una scadenza in millisecondi; un solo
+** poll() attende tutti i figli in corso con timeout = scadenza più
+** vicina. Un figlio che scade viene ucciso con SIGKILL e raccolto.
+** Lo stato dei segnali del chiamante non viene toccato e ogni figlio
+** viene raccolto per pid, senza toccare gli altri figli del chiamante.
+** Senza pidfd_open (Linux < 5.3) quel figlio viene controllato con
+** waitpid(WNOHANG) a ogni giro, con poll() limitato a SBX_POLL_MS.
+*/
+#define SBX_POLL_MS 5
+#define SBX_FDS 3
+#define SBX_CHUNK 65536
+
+typedef struct s_slot {
+	t_proc			proc;
+	size_t			job;
+	struct timespec	deadline;
+}	t_slot;
+
+/*
+** Millisecondi alla scadenza, arrotondati per eccesso: arrotondando per
+** difetto poll() si sveglierebbe prima e girerebbe a vuoto fino a 1 ms.
+*/
+static long long	ms_until(const struct timespec *t)
+{
+	struct timespec	now;
+	long long		ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (t->tv_sec - now.tv_sec) * 1000000000LL + (t->tv_nsec - now.tv_nsec);
+	return (ns <= 0 ? 0 : (ns + 999999) / 1000000);
+}
+
+void	sbx_classify(t_sbx_result *r)
+{
+	if (r->timed_out)
+		r->res = 0;
+	else if (WIFEXITED(r->status))
+		r->res = WEXITSTATUS(r->status) == 0;
+	else
+		r->res = WIFSIGNALED(r->status) ? 0 : -1;
+}
+
+void	sbx_report(const t_sbx_result *r, unsigned int timeout_ms)
+{
+	if (r->res == -1)
+		printf("Bad function: sandbox error\n");
+	else if (r->timed_out && timeout_ms % 1000 == 0)
+		printf("Bad function: timed out after %u seconds\n", timeout_ms / 1000);
+	else if (r->timed_out)
+		printf("Bad function: timed out after %u ms\n", timeout_ms);
+	else if (r->res == 1)
+		printf("Nice function!\n");
+	else if (WIFEXITED(r->status))
+		printf("Bad function: exited with code %d\n", WEXITSTATUS(r->status));
+	else
+		printf("Bad function: %s\n", strsignal(WTERMSIG(r->status)));
+}
+
+/*
+** Limiti del figlio, prima di chiamare f. Per la CPU il limite rigido è
+** un secondo sopra quello morbido: allo scadere arriva SIGXCPU, che
+** compare come "CPU time limit exceeded" invece di un SIGKILL anonimo.
+*/
+static void	set_limit(int resource, rlim_t soft, rlim_t hard)
+{
+	struct rlimit	rl = {.rlim_cur = soft, .rlim_max = hard};
+
+	setrlimit(resource, &rl);
+}
+
+void	sbx_apply_limits(const t_sbx_opts *o)
+{
+	if (o->cpu_sec)
+		set_limit(RLIMIT_CPU, o->cpu_sec, o->cpu_sec + 1);
+	if (o->as_bytes)
+		set_limit(RLIMIT_AS, o->as_bytes, o->as_bytes);
+	if (o->nofile)
+		set_limit(RLIMIT_NOFILE, o->nofile, o->nofile);
+}
+
+void	sbx_account(t_sbx_result *r, const t_proc *p)
+{
+	r->status = p->status;
+	r->user_us = p->user_us;
+	r->sys_us = p->sys_us;
+	r->maxrss_kb = p->maxrss_kb;
+	r->minflt = p->minflt;
+	r->majflt = p->majflt;
+}
+
+/*
+** Cattura (opts->capture > 0): stdout e stderr del figlio vanno in due
+** pipe il cui lato del padre è non bloccante e viene svuotato nello
+** stesso poll() che attende i pidfd, così il figlio non si blocca mai
+** su una pipe piena. Si tengono al più capture byte per flusso, il
+** resto viene letto e scartato (truncated). Niente file temporanei.
+*/
+static void	drain(struct pollfd *p, char **buf, size_t *len, size_t cap,
+		bool *truncated)
+{
+	char	chunk[SBX_CHUNK];
+	ssize_t	n;
+	size_t	keep;
+	char	*tmp;
+
+	while (p->fd != -1)
+	{
+		n = read(p->fd, chunk, sizeof(chunk));
+		if (n == -1 && errno == EINTR)
+			continue ;
+		if (n == -1 && errno == EAGAIN)
+			return ;
+		if (n <= 0)
+			break ;
+		keep = cap - *len < (size_t)n ? cap - *len : (size_t)n;
+		*truncated |= keep < (size_t)n;
+		if (!keep)
+			continue ;
+		tmp = realloc(*buf, *len + keep + 1);
+		if (!tmp)
+			break ;
+		*buf = tmp;
+		memcpy(*buf + *len, chunk, keep);
+		*len += keep;
+		(*buf)[*len] = '\0';
+	}
+	close(p->fd);
+	p->fd = -1;
+}
+
+static void	drain_all(struct pollfd *p, t_sbx_result *r, size_t cap)
+{
+	drain(&p[1], &r->out, &r->out_len, cap, &r->truncated);
+	drain(&p[2], &r->err, &r->err_len, cap, &r->truncated);
+}
+
+static int	capture_pipes(int out[2], int err[2])
+{
+	out[0] = -1;
+	err[0] = -1;
+	if (proc_pipe(out, 0) == -1)
+		return (-1);
+	if (proc_pipe(err, 0) == -1)
+		return (close(out[0]), close(out[1]), out[0] = -1, -1);
+	fcntl(out[0], F_SETFL, O_NONBLOCK);
+	fcntl(err[0], F_SETFL, O_NONBLOCK);
+	return (0);
+}
+
+/*
+** Lancia il job nello slot s. p sono le SBX_FDS voci di poll dello
+** slot: il pidfd (-1 se il kernel non li supporta) e le due pipe di
+** cattura (-1 se non si cattura). Ritorna -1 se fork fallisce (il
+** risultato resta -1).
+*/
+static int	start(t_slot *s, struct pollfd *p, size_t job,
+		void (*f)(void), const t_sbx_opts *o, t_sbx_result *r)
+{
+	unsigned int	timeout_ms = o->timeout_ms;
+	int				out[2] = {-1, -1};
+	int				err[2] = {-1, -1};
+
+	*r = (t_sbx_result){.res = -1};
+	s->job = job;
+	if (o->capture && capture_pipes(out, err) == -1)
+		return (-1);
+	if (proc_fork(&s->proc, o->capture ? (int [3]){-1, out[1], err[1]}
+		: NULL) == 0)
+	{
+		if (o->capture)
+			setvbuf(stdout, NULL, _IOLBF, 0);
+		sbx_apply_limits(o);
+		f();
+		exit(0);
+	}
+	if (o->capture)
+	{
+		close(out[1]);
+		close(err[1]);
+	}
+	if (s->proc.pid == -1)
+		return (o->capture ? (close(out[0]), close(err[0]), -1) : -1);
+	p[0] = (struct pollfd){.fd = proc_pidfd(&s->proc), .events = POLLIN};
+	p[1] = (struct pollfd){.fd = out[0], .events = POLLIN};
+	p[2] = (struct pollfd){.fd = err[0], .events = POLLIN};
+	clock_gettime(CLOCK_MONOTONIC, &s->deadline);
+	s->deadline.tv_sec += timeout_ms / 1000;
+	s->deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (s->deadline.tv_nsec >= 1000000000L)
+	{
+		s->deadline.tv_sec++;
+		s->deadline.tv_nsec -= 1000000000L;
+	}
+	return (0);
+}
+
+/*
+** Il figlio dello slot è terminato? Con pidfd lo dice poll, senza lo
+** si chiede a wait4 (proc_wait con WNOHANG; il figlio resta raccolto
+** in s->proc).
+*/
+static bool	exited(t_slot *s, struct pollfd *p)
+{
+	if (p[0].fd != -1)
+		return (p[0].revents != 0);
+	return (proc_wait(&s->proc, WNOHANG) != 0);
+}
+
+/*
+** Raccoglie il figlio dello slot i (proc_wait chiude anche il suo
+** pidfd); con kill lo uccide prima (timeout).
+** Quello che resta nelle pipe di cattura viene letto senza attendere
+** (un nipote potrebbe tenerle aperte). Lo slot viene riempito con
+** l'ultimo, così gli slot attivi restano contigui in slot[0..*running).
+*/
+static void	finish(t_slot *slot, struct pollfd *pfd, int i, int *running,
+		t_sbx_result *res, size_t cap, bool kill_it)
+{
+	t_sbx_result	*r = &res[slot[i].job];
+	struct pollfd	*p = &pfd[i * SBX_FDS];
+
+	if (kill_it && !slot[i].proc.reaped)
+		kill(slot[i].proc.pid, SIGKILL);
+	if (proc_wait(&slot[i].proc, 0) == 1)
+	{
+		sbx_account(r, &slot[i].proc);
+		r->timed_out = kill_it;
+		sbx_classify(r);
+	}
+	drain_all(p, r, cap);
+	for (int k = 1; k < SBX_FDS; k++)
+		if (p[k].fd != -1)
+			close(p[k].fd);
+	(*running)--;
+	slot[i] = slot[*running];
+	memcpy(p, &pfd[*running * SBX_FDS], SBX_FDS * sizeof(*p));
+}
+
+static int	next_timeout(t_slot *slot, struct pollfd *pfd, int running,
+		unsigned int timeout_ms)
+{
+	long long	ms = -1;
+
+	for (int i = 0; i < running; i++)
+	{
+		long long	left = timeout_ms ? ms_until(&slot[i].deadline) : -1;
+
+		if (pfd[i * SBX_FDS].fd == -1 && (left == -1 || left > SBX_POLL_MS))
+			left = SBX_POLL_MS;
+		if (left != -1 && (ms == -1 || left < ms))
+			ms = left;
+	}
+	return (ms > INT_MAX ? INT_MAX : (int)ms);
+}
+
+/*
+** fs: n funzioni, res: n risultati. Ritorna quante funzioni sono
+** "nice", -1 se non è stato possibile allocare gli slot. Con la
+** cattura attiva i buffer dei risultati vanno liberati con
+** sandbox_free. Un job che non parte (fork o pipe di cattura fallite)
+** resta con res -1; se in un giro non ne parte nessuno non si entra
+** in poll(), che senza fd e senza scadenze attenderebbe per sempre.
+*/
+int	sandbox_batch(void (**fs)(void), size_t n, const t_sbx_opts *opts,
+		t_sbx_result *res)
+{
+	t_sbx_opts		o = opts ? *opts : (t_sbx_opts){0};
+	int				par = o.parallel > 0 ? o.parallel
+		: (int)sysconf(_SC_NPROCESSORS_ONLN);
+	t_slot			*slot;
+	struct pollfd	*pfd;
+	size_t			next = 0;
+	int				running = 0;
+	int				nice = 0;
+
+	par = par > 0 ? par : 1;
+	slot = malloc(par * sizeof(*slot));
+	pfd = malloc(par * SBX_FDS * sizeof(*pfd));
+	if (!slot || !pfd)
+		return (free(slot), free(pfd), -1);
+	fflush(NULL);
+	while (next < n || running > 0)
+	{
+		while (running < par && next < n)
+		{
+			if (start(&slot[running], &pfd[running * SBX_FDS], next,
+					fs[next], &o, &res[next]) == 0)
+				running++;
+			next++;
+		}
+		if (running <= 0)
+			continue ;
+		if (poll(pfd, running * SBX_FDS, next_timeout(slot, pfd, running,
+					o.timeout_ms)) == -1 && errno != EINTR)
+			break ;
+		for (int i = running - 1; i >= 0; i--)
+		{
+			struct pollfd	*p = &pfd[i * SBX_FDS];
+
+			if (p[1].revents || p[2].revents)
+				drain_all(p, &res[slot[i].job], o.capture);
+			if (exited(&slot[i], p))
+				finish(slot, pfd, i, &running, res, o.capture, false);
+			else if (o.timeout_ms && ms_until(&slot[i].deadline) == 0)
+				finish(slot, pfd, i, &running, res, o.capture, true);
+		}
+	}
+	while (running > 0)
+		finish(slot, pfd, running - 1, &running, res, o.capture, true);
+	for (size_t i = 0; i < n; i++)
+	{
+		nice += res[i].res == 1;
+		if (o.verbose)
+			sbx_report(&res[i], o.timeout_ms);
+	}
+	free(slot);
+	free(pfd);
+	return (nice);
+}
+
+/*
+** Libera i buffer di cattura di n risultati.
+*/
+void	sandbox_free(t_sbx_result *res, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		free(res[i].out);
+		free(res[i].err);
+		res[i].out = NULL;
+		res[i].err = NULL;
+	}
+}
+
+// void	nice_ft(void)
+// {
+// 	usleep(20000);
+// }
+
+// void	bad_ft_segfault(void)
+// {
+// 	char	*str = NULL;
+// 	str[2] = 'a';
+// }
+
+// void	bad_ft_timeout(void)
+// {
+// 	while (1)
+// 		;
+// }
+
+// void	bad_ft_memory(void)
+// {
+// 	for (size_t i = 0; i < 1000; i++)
+// 		if (!malloc(1 << 20))
+// 			exit(2);
+// }
+
+// void	chatty_ft(void)
+// {
+// 	printf("hello\n");
+// 	fprintf(stderr, "oops\n");
+// 	for (int i = 0; i < 200000; i++)
+// 		putchar('x');
+// }
+
+// int	main(void)
+// {
+// 	void			(*fs[40])(void);
+// 	t_sbx_result	res[40];
+// 	t_sbx_opts		opts = {.timeout_ms = 50, .parallel = 20, .verbose = true};
+
+// 	for (int i = 0; i < 40; i++)
+// 		fs[i] = i % 10 == 3 ? bad_ft_segfault : i % 10 == 7 ? bad_ft_timeout : nice_ft;
+// 	printf("nice: %d\n", sandbox_batch(fs, 40, &opts, res));	// 32, in ~0.1s
+// 	fs[0] = bad_ft_memory;
+// 	fs[1] = bad_ft_timeout;
+// 	opts = (t_sbx_opts){.as_bytes = 256 << 20, .cpu_sec = 1, .verbose = true};
+// 	sandbox_batch(fs, 2, &opts, res);				// code 2, CPU time limit
+// 	for (int i = 0; i < 2; i++)
+// 		printf("cpu %lldus rss %ldKB minflt %ld\n", res[i].user_us + res[i].sys_us,
+// 			res[i].maxrss_kb, res[i].minflt);
+// 	fs[0] = chatty_ft;
+// 	fs[1] = bad_ft_segfault;
+// 	opts = (t_sbx_opts){.capture = 1024, .parallel = 2};
+// 	sandbox_batch(fs, 2, &opts, res);
+// 	printf("out %zu [%.6s] err [%s] truncated %d\n", res[0].out_len,
+// 		res[0].out, res[0].err, res[0].truncated);	// 1024 [hello\n] oops
+// 	sandbox_free(res, 2);
+// 	return (0);
+// }
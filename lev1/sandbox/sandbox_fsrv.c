@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+#include "sandbox.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+/*
+** Fork server, come quello di AFL: ogni sandbox() fa fork dell'intero
+** chiamante, che può essere grande e deve rifare ogni volta la propria
+** preparazione. fsrv_start crea una volta sola un server (fork del
+** chiamante, quando è ancora piccolo), che esegue init e poi resta
+** fermo su recv(). Per ogni fsrv_run il server fa fork di se stesso,
+** già preparato, esegue la funzione nel nipote e rimanda l'esito.
+**
+** Le funzioni viaggiano come puntatori: il server è una copia del
+** chiamante, quindi gli indirizzi del codice sono gli stessi.
+**
+** Protocollo (socketpair SOCK_SEQPACKET, un messaggio per richiesta):
+**   richiesta: t_fsrv_req { f, opts }
+**   risposta:  t_fsrv_rep { proc, timed_out, err } (proc con stato e
+**              misure del figlio, raccolto dal server)
+**
+** Il timeout lo gestisce il server, che è il padre del figlio: può
+** ucciderlo e raccoglierlo senza rischio di riuso del pid.
+** Il server termina quando il chiamante chiude il socket.
+*/
+#define FSRV_POLL_MS 5
+
+typedef struct s_fsrv_req {
+	void		(*f)(void);
+	t_sbx_opts	opts;
+}	t_fsrv_req;
+
+typedef struct s_fsrv_rep {
+	t_proc	proc;
+	int		timed_out;
+	int		err;
+}	t_fsrv_rep;
+
+/*
+** SERVER
+*/
+
+/*
+** Attende il figlio al massimo timeout_ms (0 = senza limite); allo
+** scadere lo uccide. Senza pidfd controlla con WNOHANG ogni
+** FSRV_POLL_MS.
+*/
+static void	wait_child(t_proc *p, unsigned int timeout_ms, t_fsrv_rep *rep)
+{
+	struct pollfd	pfd = {.fd = proc_pidfd(p), .events = POLLIN};
+	long long		left = timeout_ms;
+	struct timespec	now;
+	int				r;
+
+	while ((r = proc_wait(p, WNOHANG)) == 0)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (timeout_ms)
+			left = timeout_ms - ((now.tv_sec - p->start.tv_sec) * 1000LL
+					+ (now.tv_nsec - p->start.tv_nsec) / 1000000);
+		if (timeout_ms && left <= 0)
+		{
+			kill(p->pid, SIGKILL);
+			rep->timed_out = 1;
+			r = proc_wait(p, 0);
+			break ;
+		}
+		if (pfd.fd == -1 && (!timeout_ms || left > FSRV_POLL_MS))
+			left = FSRV_POLL_MS;
+		if (left > INT_MAX)
+			left = INT_MAX;
+		poll(pfd.fd == -1 ? NULL : &pfd, pfd.fd != -1,
+			timeout_ms || pfd.fd == -1 ? (int)left : -1);
+	}
+	if (r == -1)
+		rep->err = errno;
+	rep->proc = *p;
+}
+
+static void	fsrv_loop(int sock)
+{
+	t_fsrv_req	req;
+	t_fsrv_rep	rep;
+	t_proc		proc;
+	ssize_t		n;
+
+	while (1)
+	{
+		n = recv(sock, &req, sizeof(req), 0);
+		if (n == -1 && errno == EINTR)
+			continue ;
+		if (n != sizeof(req))
+			break ;
+		rep = (t_fsrv_rep){0};
+		fflush(NULL);
+		if (proc_fork(&proc, NULL) == 0)
+		{
+			close(sock);
+			sbx_apply_limits(&req.opts);
+			req.f();
+			exit(0);
+		}
+		if (proc.pid == -1)
+			rep.err = errno;
+		else
+			wait_child(&proc, req.opts.timeout_ms, &rep);
+		while (send(sock, &rep, sizeof(rep), MSG_NOSIGNAL) == -1
+			&& errno == EINTR)
+			;
+	}
+	_exit(0);
+}
+
+/*
+** fsrv_start: init (se non NULL) viene eseguita una volta nel server,
+** prima di servire le richieste; quello che prepara lo ereditano tutti
+** i figli. Il server chiude tutti i fd tranne stdin/stdout/stderr e il
+** suo socket. Ritorna 0, -1 in caso di errore.
+*/
+int	fsrv_start(t_fsrv *s, void (*init)(void))
+{
+	int	sv[2];
+
+	s->proc = (t_proc){.pid = -1, .pidfd = -1};
+	s->sock = -1;
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+		return (-1);
+	fflush(NULL);
+	if (proc_fork(&s->proc, NULL) == 0)
+	{
+		if (sv[1] > 3)
+			syscall(SYS_close_range, 3, sv[1] - 1, 0);
+		syscall(SYS_close_range, sv[1] + 1, ~0U, 0);
+		if (init)
+			init();
+		fsrv_loop(sv[1]);
+	}
+	if (s->proc.pid == -1)
+		return (close(sv[0]), close(sv[1]), -1);
+	close(sv[1]);
+	s->sock = sv[0];
+	return (0);
+}
+
+/*
+** CLIENT
+*/
+
+/*
+** fsrv_run: come sandbox_batch con una sola funzione, ma il figlio lo
+** crea il server. opts può essere NULL (parallel e capture vengono
+** ignorati: il figlio scrive sullo stdout del server).
+** Ritorna 1 nice, 0 bad, -1 errore (server morto o fork fallita).
+*/
+int	fsrv_run(t_fsrv *s, void (*f)(void), const t_sbx_opts *opts,
+		t_sbx_result *r)
+{
+	t_fsrv_req	req = {.f = f, .opts = opts ? *opts : (t_sbx_opts){0}};
+	t_fsrv_rep	rep;
+	ssize_t		n = -1;
+
+	*r = (t_sbx_result){.res = -1};
+	if (s->sock == -1 || !f)
+		return (errno = EINVAL, -1);
+	if (send(s->sock, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req))
+		while ((n = recv(s->sock, &rep, sizeof(rep), 0)) == -1
+			&& errno == EINTR)
+			;
+	if (n == sizeof(rep) && !rep.err)
+	{
+		sbx_account(r, &rep.proc);
+		r->timed_out = rep.timed_out;
+		sbx_classify(r);
+	}
+	if (req.opts.verbose)
+		sbx_report(r, req.opts.timeout_ms);
+	return (r->res);
+}
+
+void	fsrv_stop(t_fsrv *s)
+{
+	if (s->sock == -1)
+		return ;
+	close(s->sock);
+	proc_wait(&s->proc, 0);
+	s->sock = -1;
+}
+
+// void	nice_ft(void)
+// {
+// }
+
+// void	bad_ft_segfault(void)
+// {
+// 	char	*str = NULL;
+// 	str[2] = 'a';
+// }
+
+// void	bad_ft_timeout(void)
+// {
+// 	while (1)
+// 		;
+// }
+
+// int	main(void)
+// {
+// 	t_fsrv			s;
+// 	t_sbx_result	r;
+// 	t_sbx_opts		opts = {.timeout_ms = 50, .verbose = true};
+// 	struct timespec	t0;
+// 	struct timespec	t1;
+// 	int				nice = 0;
+
+// 	fsrv_start(&s, NULL);						// prima di crescere
+// 	fsrv_run(&s, nice_ft, &opts, &r);				// Nice function!
+// 	fsrv_run(&s, bad_ft_segfault, &opts, &r);		// Segmentation fault
+// 	fsrv_run(&s, bad_ft_timeout, &opts, &r);		// timed out after 50 ms
+// 	opts.verbose = false;
+// 	clock_gettime(CLOCK_MONOTONIC, &t0);
+// 	for (int i = 0; i < 10000; i++)
+// 		nice += fsrv_run(&s, nice_ft, &opts, &r) == 1;
+// 	clock_gettime(CLOCK_MONOTONIC, &t1);
+// 	printf("%d nice, %.0f runs/s\n", nice, 10000 / ((t1.tv_sec - t0.tv_sec)
+// 		+ (t1.tv_nsec - t0.tv_nsec) / 1e9));
+// 	fsrv_stop(&s);
+// 	return (0);
+// }
@@ -0,0 +1,319 @@
+/*
+** vbc_bench: genera espressioni casuali e misura le implementazioni di vbc.
+**
+** Compilazione:
+**   cc -O2 vbc_bench.c -o vbc_bench
+**   cc -O2 ../vbc_passed_at_exam.c -o vbc_exam
+**   (cd ../my_version && cc -O2 -pthread *.c -o ../bench/vbc_mine)
+**
+** Uso:
+**   ./vbc_bench [-n count] [-s literals] [-d depth] [-m mul%] [-p paren%]
+**               [-r seed] "impl" ["impl" ...]
+**
+**   -n: numero di espressioni (default 1000)
+**   -s: cifre per espressione (default 32)
+**   -d: profondità massima delle parentesi (default 4)
+**   -m: percentuale di '*' tra gli operatori (default 50)
+**   -p: probabilità in % che un operando diventi "(sotto-espressione)"
+**
+** Ogni "impl" è una riga di comando separata da spazi:
+**   - se contiene l'argomento "-" (es. "./vbc_mine -f -") viene lanciata
+**     una volta sola e riceve tutte le espressioni su stdin, una per riga
+**   - altrimenti viene lanciata una volta per espressione, con
+**     l'espressione come ultimo argomento (come all'esame)
+** La prima implementazione fa da riferimento: per le altre si contano
+** le righe di output diverse. Per ognuna si stampano espressioni/s,
+** MB/s di input e il picco di memoria (ru_maxrss da wait4).
+*/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define MAX_ARGS 32
+
+typedef struct s_gen {
+	int	literals;
+	int	depth;
+	int	mul;
+	int	paren;
+}	t_gen;
+
+typedef struct s_buf {
+	char	*data;
+	size_t	len;
+	size_t	cap;
+}	t_buf;
+
+typedef struct s_stats {
+	double	seconds;
+	long	max_rss;
+	size_t	mismatches;
+	int		failed;
+}	t_stats;
+
+static void	buf_push(t_buf *b, const char *src, size_t n)
+{
+	if (b->len + n + 1 > b->cap)
+	{
+		while (b->len + n + 1 > b->cap)
+			b->cap = b->cap ? b->cap * 2 : 4096;
+		b->data = realloc(b->data, b->cap);
+		if (!b->data)
+		{
+			perror("realloc");
+			exit(1);
+		}
+	}
+	memcpy(b->data + b->len, src, n);
+	b->len += n;
+	b->data[b->len] = '\0';
+}
+
+/*
+** Scrive in b un'espressione con esattamente n cifre. Ogni operando è
+** una cifra oppure, con probabilità paren%, una sotto-espressione tra
+** parentesi con una parte delle cifre rimaste.
+*/
+static void	gen_expr(t_buf *b, const t_gen *g, int n, int depth)
+{
+	while (n > 0)
+	{
+		int	take = 1;
+
+		if (depth > 0 && n > 1 && rand() % 100 < g->paren)
+		{
+			take = 1 + rand() % n;
+			buf_push(b, "(", 1);
+			gen_expr(b, g, take, depth - 1);
+			buf_push(b, ")", 1);
+		}
+		else
+			buf_push(b, &"0123456789"[rand() % 10], 1);
+		n -= take;
+		if (n > 0)
+			buf_push(b, rand() % 100 < g->mul ? "*" : "+", 1);
+	}
+}
+
+static double	now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+** Lancia argv con in come stdin (se non NULL) e raccoglie lo stdout in
+** out. Scrittura e lettura sono alternate con poll per non bloccarsi
+** quando entrambe le pipe sono piene. Ritorna lo status di wait4,
+** -1 se pipe/fork falliscono. *rss riceve ru_maxrss in KB.
+*/
+static int	run(char **argv, const t_buf *in, t_buf *out, long *rss)
+{
+	int				fin[2] = {-1, -1};
+	int				fout[2];
+	pid_t			pid;
+	size_t			off = 0;
+	char			chunk[65536];
+	struct rusage	ru;
+	int				status;
+
+	if (pipe(fout) == -1 || (in && pipe(fin) == -1))
+		return (-1);
+	pid = fork();
+	if (pid == -1)
+		return (-1);
+	if (pid == 0)
+	{
+		if (in && dup2(fin[0], STDIN_FILENO) == -1)
+			exit(1);
+		if (dup2(fout[1], STDOUT_FILENO) == -1)
+			exit(1);
+		if (in)
+			(close(fin[0]), close(fin[1]));
+		close(fout[0]);
+		close(fout[1]);
+		execvp(argv[0], argv);
+		exit(127);
+	}
+	close(fout[1]);
+	if (in)
+		close(fin[0]);
+	while (1)
+	{
+		struct pollfd	p[2] = {{fout[0], POLLIN, 0}, {fin[1], POLLOUT, 0}};
+		int				np = fin[1] != -1 ? 2 : 1;
+		ssize_t			r;
+
+		if (poll(p, np, -1) == -1)
+			break ;
+		if (np == 2 && p[1].revents)
+		{
+			r = write(fin[1], in->data + off, in->len - off);
+			off += r > 0 ? (size_t)r : 0;
+			if (r <= 0 || off == in->len)
+				(close(fin[1]), fin[1] = -1);
+		}
+		if (p[0].revents)
+		{
+			r = read(fout[0], chunk, sizeof(chunk));
+			if (r <= 0)
+				break ;
+			buf_push(out, chunk, r);
+		}
+	}
+	if (fin[1] != -1)
+		close(fin[1]);
+	close(fout[0]);
+	if (wait4(pid, &status, 0, &ru) == -1)
+		return (-1);
+	*rss = ru.ru_maxrss;
+	return (status);
+}
+
+/*
+** Spezza una riga di comando sugli spazi (niente quoting: serve solo
+** per "percorso [flag...]").
+*/
+static int	split_cmd(char *cmd, char **argv, int *stdin_mode)
+{
+	int	n = 0;
+
+	*stdin_mode = 0;
+	for (char *tok = strtok(cmd, " "); tok && n < MAX_ARGS - 2;
+		tok = strtok(NULL, " "))
+	{
+		*stdin_mode |= !strcmp(tok, "-");
+		argv[n++] = tok;
+	}
+	argv[n] = NULL;
+	return (n);
+}
+
+/*
+** Confronta riga per riga out con ref, contando le differenze.
+*/
+static size_t	count_mismatches(const t_buf *ref, const t_buf *out)
+{
+	const char	*a = ref->data ? ref->data : "";
+	const char	*b = out->data ? out->data : "";
+	size_t		diff = 0;
+
+	while (*a || *b)
+	{
+		size_t	la = strcspn(a, "\n");
+		size_t	lb = strcspn(b, "\n");
+
+		diff += la != lb || memcmp(a, b, la);
+		a += la + (a[la] == '\n');
+		b += lb + (b[lb] == '\n');
+	}
+	return (diff);
+}
+
+static t_stats	bench(char *cmd, char **exprs, size_t count, const t_buf *all,
+		t_buf *out)
+{
+	char	*argv[MAX_ARGS];
+	int		stdin_mode;
+	int		n = split_cmd(cmd, argv, &stdin_mode);
+	t_stats	st = {0};
+	long	rss = 0;
+	double	start = now();
+
+	if (stdin_mode)
+	{
+		st.failed = run(argv, all, out, &st.max_rss) == -1;
+		st.seconds = now() - start;
+		return (st);
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		argv[n] = exprs[i];
+		argv[n + 1] = NULL;
+		if (run(argv, NULL, out, &rss) == -1)
+			st.failed = 1;
+		if (rss > st.max_rss)
+			st.max_rss = rss;
+	}
+	st.seconds = now() - start;
+	return (st);
+}
+
+int	main(int argc, char **argv)
+{
+	t_gen	g = {.literals = 32, .depth = 4, .mul = 50, .paren = 20};
+	size_t	count = 1000;
+	int		opt;
+	t_buf	all = {0};
+	t_buf	ref = {0};
+	char	**exprs;
+
+	srand(42);
+	signal(SIGPIPE, SIG_IGN);
+	while ((opt = getopt(argc, argv, "n:s:d:m:p:r:")) != -1)
+	{
+		if (opt == 'n')
+			count = strtoul(optarg, NULL, 10);
+		else if (opt == 's')
+			g.literals = atoi(optarg);
+		else if (opt == 'd')
+			g.depth = atoi(optarg);
+		else if (opt == 'm')
+			g.mul = atoi(optarg);
+		else if (opt == 'p')
+			g.paren = atoi(optarg);
+		else if (opt == 'r')
+			srand(atoi(optarg));
+		else
+			return (1);
+	}
+	if (optind >= argc || g.literals < 1 || count == 0)
+		return (fprintf(stderr, "usage: %s [-n N] [-s N] [-d N] [-m %%] "
+				"[-p %%] [-r seed] impl...\n", argv[0]), 1);
+	exprs = malloc(count * sizeof(*exprs));
+	if (!exprs)
+		return (1);
+	for (size_t i = 0; i < count; i++)
+	{
+		t_buf	e = {0};
+
+		gen_expr(&e, &g, g.literals, g.depth);
+		exprs[i] = e.data;
+		buf_push(&all, e.data, e.len);
+		buf_push(&all, "\n", 1);
+	}
+	printf("%zu expressions, %zu bytes\n", count, all.len);
+	printf("%-32s %12s %10s %10s %10s\n", "impl", "exprs/s", "MB/s",
+		"peak KB", "mismatch");
+	for (int i = optind; i < argc; i++)
+	{
+		t_buf	out = {0};
+		char	*name = strdup(argv[i]);
+		t_stats	st = bench(argv[i], exprs, count, &all, &out);
+
+		if (i == optind)
+			ref = out;
+		else
+			st.mismatches = count_mismatches(&ref, &out);
+		printf("%-32s %12.0f %10.2f %10ld %10zu%s\n", name,
+			count / st.seconds, all.len / st.seconds / 1e6, st.max_rss,
+			st.mismatches, st.failed ? " (launch failed)" : "");
+		free(name);
+		if (i != optind)
+			free(out.data);
+	}
+	for (size_t i = 0; i < count; i++)
+		free(exprs[i]);
+	free(exprs);
+	free(all.data);
+	free(ref.data);
+	return (0);
+}
@@ -0,0 +1,75 @@
+/*
+** vbc_diag_check: controlla le diagnostiche di vbc_diagnose (vbc -l)
+** su una tabella di input con errori noti.
+**
+** Compilazione (tutti i sorgenti di my_version tranne il main di vbc.c):
+**   (cd ../my_version && cc -O2 -pthread -I. ../bench/vbc_diag_check.c \
+**       $(ls *.c | grep -v '^vbc.c$') -o ../bench/vbc_diag_check)
+**
+** Uso:
+**   ./vbc_diag_check
+**
+** Per ogni caso le diagnostiche (posizione e codice, come in t_diag)
+** devono essere esattamente quelle attese, nell'ordine: in particolare
+** un errore lessicale (carattere non valido, costante troppo grande)
+** compare una volta sola anche quando il token è pure in eccesso per il
+** parser.
+** Stampa una riga per caso ed esce con 1 se almeno un caso fallisce.
+*/
+#include "vbc_lib.h"
+
+#define MAX_DIAGS 8
+
+typedef struct s_case {
+	const char	*str;
+	t_mode		mode;
+	size_t		n;
+	t_diag		d[MAX_DIAGS];
+}	t_case;
+
+static const t_case	g_cases[] = {
+	{"1+2", MODE_INT, 0, {{0}}},
+	{"a", MODE_INT, 1, {{0, 'a'}}},
+	{"1 a", MODE_INT, 1, {{2, 'a'}}},
+	{"(1+2", MODE_INT, 1, {{4, 0}}},
+	{"1+2)", MODE_INT, 1, {{3, ')'}}},
+	{"1++2)*(3 a 4", MODE_INT, 3, {{2, '+'}, {4, ')'}, {9, 'a'}}},
+	{"1 99999999999999999999999 2", MODE_INT, 1, {{2, BAD_TOO_LARGE}}},
+	{"1 99999999999999999999999 2", MODE_BIG, 1, {{2, '9'}}},
+	{"1+99999999999999999999999", MODE_CHECKED, 1, {{2, BAD_TOO_LARGE}}},
+	{"a+b*(c", MODE_INT, 4, {{0, 'a'}, {2, 'b'}, {5, 'c'}, {6, 0}}},
+};
+
+static int	same(const t_case *c, const t_diags *d)
+{
+	if (d->len != c->n)
+		return (0);
+	for (size_t i = 0; i < c->n; i++)
+		if (d->v[i].pos != c->d[i].pos || d->v[i].c != c->d[i].c)
+			return (0);
+	return (1);
+}
+
+int	main(void)
+{
+	t_vbc_ctx	ctx;
+	t_diags		diags = {0};
+	int			ret = 0;
+
+	vbc_ctx_init(&ctx);
+	for (size_t i = 0; i < sizeof(g_cases) / sizeof(*g_cases); i++)
+	{
+		const t_case	*c = &g_cases[i];
+		int				ok;
+
+		ctx.mode = c->mode;
+		ok = vbc_diagnose(&ctx, c->str, &diags) >= 0 && same(c, &diags);
+		printf("%-4s \"%s\"\n", ok ? "ok" : "FAIL", c->str);
+		if (!ok)
+			diag_print(&diags, 0);
+		ret |= !ok;
+	}
+	diag_free(&diags);
+	vbc_ctx_destroy(&ctx);
+	return (ret);
+}
@@ -0,0 +1,160 @@
+/*
+** vbc_incr_check: controlla la rivalutazione incrementale (vbc_incr.c)
+** contro una valutazione completa.
+**
+** Compilazione (tutti i sorgenti di my_version tranne il main di vbc.c):
+**   (cd ../my_version && cc -O2 -pthread -I. ../bench/vbc_incr_check.c \
+**       $(ls *.c | grep -v '^vbc.c$') -o ../bench/vbc_incr_check)
+**
+** Uso:
+**   ./vbc_incr_check [-n terms] [-k edits] [-r seed]
+**
+**   -n: termini delle espressioni lunghe (default 1000000)
+**   -k: foglie modificate per ogni espressione e modalità (default 20)
+**   -r: seme del generatore (default 42)
+**
+** Per ogni forma di espressione (somma piatta, somma di prodotti,
+** parentesi annidate) e per MODE_INT e MODE_CHECKED: incr_prepare,
+** poi k modifiche di foglie scelte a caso con incr_set_leaf; dopo ogni
+** modifica incr_result deve coincidere con eval_parallel sull'albero
+** intero (con un thread, che non ricorre lungo le catene). In
+** MODE_CHECKED alcune modifiche mettono valori enormi per provocare e
+** poi togliere un overflow.
+** Stampa una riga per caso ed esce con 1 al primo risultato diverso.
+*/
+#include "vbc_lib.h"
+#include <limits.h>
+
+#define NEST_MAX 10000
+
+typedef struct s_buf {
+	char	*data;
+	size_t	len;
+}	t_buf;
+
+static void	put(t_buf *b, char c)
+{
+	b->data[b->len++] = c;
+}
+
+/*
+** Forme: 0 = "d+d+...", 1 = "d*d+d*d+...", 2 = "d+(d+(d+...))" (al
+** più NEST_MAX livelli: il parser ricorre sulle parentesi).
+** Ritorna il numero di foglie.
+*/
+static size_t	gen_expr(t_buf *b, int shape, size_t terms)
+{
+	size_t	leaves = 0;
+
+	if (shape == 2 && terms > NEST_MAX)
+		terms = NEST_MAX;
+	b->data = malloc(terms * 5 + 1);
+	b->len = 0;
+	if (!b->data)
+		return (0);
+	for (size_t i = 0; i < terms; i++)
+	{
+		put(b, '0' + rand() % 10);
+		leaves++;
+		if (shape == 1)
+		{
+			put(b, '*');
+			put(b, '0' + rand() % 10);
+			leaves++;
+		}
+		if (i + 1 < terms)
+			put(b, '+');
+		if (shape == 2 && i + 1 < terms)
+			put(b, '(');
+	}
+	for (size_t i = 1; shape == 2 && i < terms; i++)
+		put(b, ')');
+	put(b, '\0');
+	return (leaves);
+}
+
+static int	same(const t_result *a, const t_result *b)
+{
+	if (a->err || b->err)
+		return (a->err == b->err);
+	if (a->mode == MODE_INT)
+		return (a->i == b->i);
+	return (a->ll == b->ll);
+}
+
+static int	check(node *tree, t_mode mode, size_t leaves, int edits)
+{
+	t_result	inc;
+	t_result	ref;
+	size_t		idx;
+	long long	val;
+
+	if (incr_prepare(tree, mode))
+		return (-1);
+	for (int k = 0; k <= edits; k++)
+	{
+		if (k > 0)
+		{
+			idx = (size_t)rand() % leaves;
+			val = rand() % 10;
+			if (mode == MODE_CHECKED && k % 5 == 0)
+				val = LLONG_MAX / 3;
+			incr_set_leaf(leaf_at(tree, &idx), val, mode);
+		}
+		incr_result(tree, mode, &inc);
+		eval_parallel(tree, mode, 1, &ref);
+		if (!same(&inc, &ref))
+			return (-1);
+	}
+	return (0);
+}
+
+int	main(int argc, char **argv)
+{
+	static const char	*shapes[] = {"flat sum", "sum of products",
+		"nested"};
+	size_t				terms = 1000000;
+	int					edits = 20;
+	t_vbc_ctx			ctx;
+	t_buf				b;
+	int					bad;
+	int					opt;
+	int					ret = 0;
+
+	srand(42);
+	while ((opt = getopt(argc, argv, "n:k:r:")) != -1)
+	{
+		if (opt == 'n')
+			terms = strtoul(optarg, NULL, 10);
+		else if (opt == 'k')
+			edits = atoi(optarg);
+		else if (opt == 'r')
+			srand(strtoul(optarg, NULL, 10));
+		else
+			return (fprintf(stderr, "usage: %s [-n terms] [-k edits] "
+					"[-r seed]\n", argv[0]), 2);
+	}
+	if (terms == 0)
+		terms = 1;
+	vbc_ctx_init(&ctx);
+	for (int shape = 0; shape < 3 && !ret; shape++)
+	{
+		size_t	leaves = gen_expr(&b, shape, terms);
+		node	*tree = leaves ? vbc_parse(&ctx, b.data, &bad) : NULL;
+
+		for (t_mode mode = MODE_INT; tree && mode <= MODE_CHECKED && !ret;
+			mode++)
+		{
+			ret = check(tree, mode, leaves, edits) != 0;
+			printf("%-16s %-7s %8zu leaves: %s\n", shapes[shape],
+				mode == MODE_INT ? "int" : "checked", leaves,
+				ret ? "MISMATCH" : "ok");
+		}
+		if (!tree)
+			ret = (printf("%s: parse failed\n", shapes[shape]), 1);
+		destroy_tree(tree);
+		free(b.data);
+	}
+	vbc_ctx_destroy(&ctx);
+	return (ret);
+}
@@ -3,17 +3,6 @@
 #include <ctype.h>
 #include "vbc.h"
 
-typedef struct node {
-	enum {
-		ADD,
-		MULTI,
-		VAL
-	}   type;
-	int val;
-	struct node *l;
-	struct node *r;
-}   node;
-
 node	*new_node(node n)
 {
 	node *ret = calloc(1, sizeof(n));
@@ -23,16 +12,28 @@ node	*new_node(node n)
 	return (ret);
 }
 
+/*
+** Iterativa lungo il figlio sinistro: il parser costruisce catene
+** sinistre (1+2+3 -> ADD(ADD(1,2),3)) che con la ricorsione semplice
+** esaurirebbero lo stack su espressioni molto lunghe.
+*/
 void	destroy_tree(node *n)
 {
-	if (!n)
-		return ;
-	if (n->type != VAL)
+	node	*next;
+
+	while (n)
 	{
-		destroy_tree(n->l);
-		destroy_tree(n->r);
+		next = NULL;
+		if (n->type != VAL)
+		{
+			destroy_tree(n->r);
+			next = n->l;
+		}
+		else
+			big_free(&n->big);
+		free(n);
+		n = next;
 	}
-	free(n);
 }
 void	unexpected(char c)
 {
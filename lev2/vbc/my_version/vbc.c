@@ -1,93 +1,101 @@
-#include "vbc.h"
+#include "vbc_lib.h"
 
-char *s;
+/*
+** Uso:
+**   ./vbc [-c | -b] [-x] "espressione"
+**   ./vbc [-c | -b] [-j N] [-C N] -f file     (file "-" = stdin)
+**   ./vbc -l "espressione" | -l -f file
+**   -c: aritmetica a 64 bit con controllo dell'overflow
+**   -b: aritmetica a precisione arbitraria
+**   -f: modalità batch, un'espressione per riga (vedi vbc_batch.c)
+**   -j: numero di thread per la valutazione (in modalità batch le
+**       righe, altrimenti le catene larghe di una singola espressione),
+**       ridotto all'intervallo [1, THREADS_PER_CPU * CPU]
+**   -C: in modalità batch tiene in cache le ultime N espressioni
+**       distinte con il loro risultato (statistiche su stderr)
+**   -l: lint, elenca tutti gli errori con la loro posizione invece di
+**       fermarsi al primo (vbc_diagnose); non valuta nulla
+**   -x: valuta con il JIT x86-64 (fallback sull'interprete se non
+**       disponibile, ad esempio con -b o su altre architetture)
+** Senza flag si comporta come l'esercizio originale (int).
+*/
+#define THREADS_PER_CPU 4
 
-int is_whitespace(char c)
+/*
+** I thread finiscono in array sullo stack (vbc_batch.c,
+** vbc_parallel.c): un -j enorme o negativo non deve arrivarci.
+*/
+static int	parse_threads(const char *s)
 {
-	return (c == ' ' || c == '\t' || c == '\n');
-}
-
-void skip_whitespace()
-{
-	while(is_whitespace(*s))
-		s++;
-}
-int ft_product()
-{
-	int	a = ft_factor();
-	while(*s == '*')
-	{
-		s++;
-		a = a * ft_factor();
-	}
-	return(a);
-}
+	long	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	long	max = (cpus > 0 ? cpus : 1) * THREADS_PER_CPU;
+	long	n = strtol(s, NULL, 10);
 
-int ft_sum()
-{
-	int sum = ft_product();
-	while(*s == '+')
-	{
-		s++;
-		sum += ft_product();
-	}
-	return(sum);
+	if(n < 1)
+		return(1);
+	return(n > max ? (int)max : (int)n);
 }
 
-int	ft_factor()
+int main(int argc, char **argv)
 {
-	int	n;
+	t_mode		mode = MODE_INT;
+	char		*file = NULL;
+	int			threads = 1;
+	size_t		cache = 0;
+	int			use_jit = 0;
+	int			lint = 0;
+	t_diags		diags = {0};
+	t_vbc_ctx	ctx;
+	t_jit		*jit = NULL;
+	int			i = 1;
+	int			bad;
+	node		*tree;
+	t_result	res;
 
-	skip_whitespace();
-	if(isdigit(*s))
-		return(*s++ - '0');
-	if(*s == '(')
+	for(; i < argc && argv[i][0] == '-'; i++)
 	{
-		s++;
-		n = ft_sum();
-		skip_whitespace();
-		if(*s == ')')
-			s++;
-		return (n);
+		if(!strcmp(argv[i], "-c"))
+			mode = MODE_CHECKED;
+		else if(!strcmp(argv[i], "-b"))
+			mode = MODE_BIG;
+		else if(!strcmp(argv[i], "-l"))
+			lint = 1;
+		else if(!strcmp(argv[i], "-x"))
+			use_jit = 1;
+		else if(!strcmp(argv[i], "-f") && i + 1 < argc)
+			file = argv[++i];
+		else if(!strcmp(argv[i], "-j") && i + 1 < argc)
+			threads = parse_threads(argv[++i]);
+		else if(!strcmp(argv[i], "-C") && i + 1 < argc)
+			cache = strtoul(argv[++i], NULL, 10);
+		else
+			return(1);
 	}
-	return (0);
-}
-
-int check_input(char *str)
-{
-	int par = 0;
-	int i = 0;
-	char prev = 0;
-	while(str[i])
+	if(file)
+		return(i == argc ? run_batch(file, mode, threads, cache, lint) : 1);
+	if(i != argc - 1)
+		return(1);
+	vbc_ctx_init(&ctx);
+	ctx.mode = mode;
+	if(lint)
 	{
-		if(is_whitespace(str[i]))
-		{
-			i++;
-			continue;
-		}
-		par += (str[i] == '(') - (str[i] == ')');
-		if(par < 0)
-			return(unexpected(')'), 1);
-		if(isdigit(str[i]) && isdigit(prev))
-			return(unexpected(str[i]), 1);
-		prev = str[i];
-		i++;
+		bad = vbc_diagnose(&ctx, argv[i], &diags);
+		diag_print(&diags, 0);
+		diag_free(&diags);
+		vbc_ctx_destroy(&ctx);
+		return(bad != 0);
 	}
-	if(par > 0)
-		return(unexpected('('), 1);
-	if(prev == '+' || prev == '*')
-		return(unexpected(0), 1);
-	return(0);
-}
-
-int main(int argc, char **argv)
-{
-	if(argc != 2)
-		return(1);
-	if(check_input(argv[1]))
-		return(1);
-	s = argv[1];
-	int res = ft_sum();
-	printf("%d\n", res);
-	return(0);
+	tree = vbc_parse(&ctx, argv[i], &bad);
+	vbc_ctx_destroy(&ctx);
+	if(!tree)
+		return(bad >= 0 ? report_bad(bad) : (void)0, 1);
+	if(use_jit)
+		jit = jit_compile(tree, mode);
+	if(jit)
+		jit_run(jit, &res);
+	else
+		eval_parallel(tree, mode, threads, &res);
+	jit_free(jit);
+	destroy_tree(tree);
+	return(print_result(&res));
 }
@@ -6,11 +6,214 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
 
+/*
+** Intero senza segno a precisione arbitraria.
+** limb[] contiene cifre in base 10^9, dalla meno significativa;
+** len è il numero di limb significativi (0 rappresenta il valore zero).
+*/
+# define BIG_BASE 1000000000u
 
-void unexpected(char c);
-int ft_factor();
-int ft_product();
-int ft_sum();
+typedef struct s_big {
+	uint32_t	*limb;
+	size_t		len;
+}	t_big;
 
-#endif
\ No newline at end of file
+/*
+** Nodo dell'albero dell'espressione (layout di given.c più i campi per
+** la rivalutazione incrementale di vbc_incr.c: padre e valore del
+** sottoalbero in cache). Il parser costruisce l'albero una sola volta,
+** poi lo si valuta nella modalità numerica scelta da riga di comando.
+** big: valore di un letterale che non sta in un long long (solo in
+** MODE_BIG, len 0 altrimenti); lo libera destroy_tree.
+*/
+typedef struct node {
+	enum {
+		ADD,
+		MULTI,
+		VAL
+	}   type;
+	long long val;
+	struct node *l;
+	struct node *r;
+	struct node *parent;
+	long long cache;
+	int cache_err;
+	t_big big;
+}   node;
+
+/*
+** Token prodotti da tokenize() (vbc_lexer.c). c è il primo carattere
+** del token, usato per i messaggi di errore (0 per T_END), pos il suo
+** offset nella stringa e len la sua lunghezza (per T_NUM le cifre).
+** big: numero che non sta in val (solo in MODE_BIG, dove il parser lo
+** ricostruisce dal testo).
+*/
+typedef struct s_token {
+	enum {
+		T_NUM,
+		T_PLUS,
+		T_STAR,
+		T_LPAREN,
+		T_RPAREN,
+		T_END
+	}	type;
+	char		c;
+	size_t		pos;
+	size_t		len;
+	long long	val;
+	int			big;
+	int			reported;
+}	t_token;
+
+typedef struct s_tokens {
+	t_token	*v;
+	size_t	len;
+	size_t	cap;
+}	t_tokens;
+
+/*
+** Diagnostica raccolta da vbc_diagnose(): offset nella stringa e
+** carattere inatteso (0 = fine dell'input), oppure BAD_TOO_LARGE per
+** una costante che non sta in un long long fuori da MODE_BIG. Gli
+** stessi codici valgono per il *bad di vbc_parse.
+*/
+# define BAD_TOO_LARGE 256
+
+typedef struct s_diag {
+	size_t	pos;
+	int		c;
+}	t_diag;
+
+typedef struct s_diags {
+	t_diag	*v;
+	size_t	len;
+	size_t	cap;
+}	t_diags;
+
+/*
+** Modalità numeriche:
+**   - MODE_INT: int come l'esercizio originale (overflow non controllato)
+**   - MODE_CHECKED: 64 bit con errore "Overflow" se il risultato non ci sta
+**   - MODE_BIG: precisione arbitraria (t_big)
+*/
+typedef enum e_mode {
+	MODE_INT,
+	MODE_CHECKED,
+	MODE_BIG
+}	t_mode;
+
+/*
+** Risultato di una valutazione, separato dalla stampa.
+** err: 0, RES_OVERFLOW (MODE_CHECKED) o RES_NOMEM (MODE_BIG).
+*/
+# define RES_OVERFLOW 1
+# define RES_NOMEM 2
+
+typedef struct s_result {
+	t_mode		mode;
+	int			err;
+	int			i;
+	long long	ll;
+	t_big		big;
+}	t_result;
+
+/*
+** Espressione compilata in codice macchina (vbc_jit.c).
+** entry punta alla funzione int f(long long *out) dentro code.
+*/
+typedef struct s_jit {
+	t_mode	mode;
+	void	*code;
+	void	*entry;
+	size_t	size;
+}	t_jit;
+
+/*
+** Cache LRU delle espressioni (vbc_cache.c): chiave = testo
+** normalizzato, valore = risultato già calcolato.
+*/
+typedef struct s_centry {
+	char			*key;
+	size_t			len;
+	size_t			hash;
+	t_result		res;
+	struct s_centry	*hnext;
+	struct s_centry	*prev;
+	struct s_centry	*next;
+}	t_centry;
+
+typedef struct s_cache {
+	t_centry		**buckets;
+	size_t			nbuckets;
+	size_t			size;
+	size_t			cap;
+	t_centry		*head;
+	t_centry		*tail;
+	size_t			hits;
+	size_t			misses;
+	size_t			evictions;
+	pthread_mutex_t	lock;
+}	t_cache;
+
+/*GIVEN*/
+node	*new_node(node n);
+void	destroy_tree(node *n);
+void	unexpected(char c);
+int		accept(char **s, char c);
+int		expect(char **s, char c);
+
+/*LEXER*/
+int		tokenize(const char *str, t_tokens *t, t_mode mode, int *bad,
+			t_diags *diags);
+
+/*DIAG*/
+void	diag_push(t_diags *d, size_t pos, int c);
+void	report_bad(int bad);
+void	diag_print(const t_diags *d, size_t line);
+void	diag_free(t_diags *d);
+
+/*EVAL*/
+int		eval_tree(node *tree);
+int		eval_checked(node *tree, long long *out);
+int		eval_big(node *tree, t_big *out);
+void	eval_result(node *tree, t_mode mode, t_result *res);
+int		print_result(t_result *res);
+
+/*INCREMENTAL*/
+int		incr_prepare(node *tree, t_mode mode);
+void	incr_set_leaf(node *leaf, long long val, t_mode mode);
+void	incr_result(node *tree, t_mode mode, t_result *res);
+node	*leaf_at(node *tree, size_t *index);
+
+/*PARALLEL*/
+void	eval_parallel(node *tree, t_mode mode, int threads, t_result *res);
+
+/*JIT*/
+t_jit	*jit_compile(node *tree, t_mode mode);
+void	jit_run(t_jit *jit, t_result *res);
+void	jit_free(t_jit *jit);
+
+/*CACHE*/
+size_t	normalize(const char *src, char *dst);
+int		cache_init(t_cache *c, size_t cap);
+int		cache_get(t_cache *c, const char *key, size_t len, t_result *res);
+void	cache_put(t_cache *c, char *key, size_t len, const t_result *res);
+void	cache_destroy(t_cache *c);
+
+/*BATCH*/
+int		run_batch(const char *path, t_mode mode, int threads, size_t cache,
+			int lint);
+
+/*BIGNUM*/
+int		big_set(t_big *dst, uint64_t v);
+int		big_from_str(t_big *dst, const char *s, size_t len);
+int		big_add(t_big *dst, const t_big *a, const t_big *b);
+int		big_mul(t_big *dst, const t_big *a, const t_big *b);
+int		big_copy(t_big *dst, const t_big *src);
+void	big_print(const t_big *n);
+void	big_free(t_big *n);
+
+#endif
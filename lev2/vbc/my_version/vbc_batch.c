@@ -0,0 +1,298 @@
+#include "vbc_lib.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+** Modalità batch: un'espressione per riga, un risultato (o errore) per
+** riga in output, nello stesso ordine dell'input. Evita di lanciare un
+** processo per ogni espressione.
+**
+** Le righe sono elaborate a blocchi di BATCH_CHUNK:
+**   1. il thread principale separa le righe
+**   2. `threads` thread analizzano e valutano ciascuno la propria parte
+**      del blocco, ognuno con il proprio t_vbc_ctx (eval_parallel con
+**      un thread evita la ricorsione sulle catene lunghe)
+**   3. stampa in ordine dei risultati
+** Con -C N le righe già viste (a meno degli spazi) non vengono né
+** analizzate né valutate: il risultato arriva dalla cache.
+** Con -l (lint) nessuna riga viene valutata: per ogni riga si stampano
+** tutte le diagnostiche come "riga:colonna: messaggio".
+*/
+#define BATCH_CHUNK 4096
+
+typedef struct s_job {
+	char		*line;
+	node		*tree;
+	int			bad;
+	int			hit;
+	char		*key;
+	size_t		keylen;
+	t_result	res;
+}	t_job;
+
+typedef struct s_batch {
+	t_mode		mode;
+	int			threads;
+	t_vbc_ctx	*ctx;
+	t_cache		cache;
+	int			lint;
+	size_t		lineno;
+	t_diags		diags;
+}	t_batch;
+
+typedef struct s_worker {
+	pthread_t	tid;
+	t_batch		*b;
+	t_vbc_ctx	*ctx;
+	t_job		*jobs;
+	size_t		count;
+}	t_worker;
+
+/*
+** Analizza una riga. Con la cache attiva la riga viene prima
+** normalizzata sul posto (la chiave non è mai più lunga della riga)
+** e cercata in cache; in caso di miss la chiave viene conservata per
+** inserire il risultato dopo la valutazione.
+*/
+static void	parse_job(t_batch *b, t_vbc_ctx *ctx, t_job *job)
+{
+	job->bad = -1;
+	if (b->cache.cap)
+	{
+		job->keylen = normalize(job->line, job->line);
+		job->hit = cache_get(&b->cache, job->line, job->keylen, &job->res);
+		if (job->hit)
+			return ;
+	}
+	job->tree = vbc_parse(ctx, job->line, &job->bad);
+	if (job->tree && b->cache.cap)
+		job->key = strndup(job->line, job->keylen);
+}
+
+static void	*run_jobs(void *arg)
+{
+	t_worker	*w = arg;
+
+	for (size_t i = 0; i < w->count; i++)
+	{
+		parse_job(w->b, w->ctx, &w->jobs[i]);
+		if (w->jobs[i].tree)
+			eval_parallel(w->jobs[i].tree, w->b->mode, 1, &w->jobs[i].res);
+	}
+	return (NULL);
+}
+
+/*
+** Analizza e valuta jobs[0..n) dividendo l'intervallo in parti uguali
+** tra i thread. Se un pthread_create fallisce, quella parte viene
+** elaborata qui. Con meno righe che thread (es. un'unica espressione
+** enorme) i thread servono di più dentro la singola espressione:
+** eval_parallel.
+*/
+static void	run_chunk(t_batch *b, t_job *jobs, size_t n)
+{
+	int			threads = b->threads;
+	t_worker	w[threads];
+	size_t		per = (n + threads - 1) / threads;
+	int			started[threads];
+
+	if (n < (size_t)threads)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			parse_job(b, &b->ctx[0], &jobs[i]);
+			if (jobs[i].tree)
+				eval_parallel(jobs[i].tree, b->mode, threads, &jobs[i].res);
+		}
+		return ;
+	}
+	for (int t = 0; t < threads; t++)
+	{
+		size_t	from = t * per < n ? t * per : n;
+		size_t	to = from + per < n ? from + per : n;
+
+		w[t] = (t_worker){.b = b, .ctx = &b->ctx[t], .jobs = jobs + from,
+			.count = to - from};
+		started[t] = t > 0 && pthread_create(&w[t].tid, NULL, run_jobs, &w[t]) == 0;
+		if (t > 0 && !started[t])
+			run_jobs(&w[t]);
+	}
+	run_jobs(&w[0]);
+	for (int t = 1; t < threads; t++)
+		if (started[t])
+			pthread_join(w[t].tid, NULL);
+}
+
+/*
+** Stampa i risultati del blocco nell'ordine delle righe. I risultati
+** valutati senza errori passano alla cache (se attiva); gli alberi
+** vengono sempre distrutti.
+*/
+static void	flush_chunk(t_batch *b, t_job *jobs, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		if (jobs[i].tree && jobs[i].key && !jobs[i].res.err)
+			cache_put(&b->cache, jobs[i].key, jobs[i].keylen, &jobs[i].res);
+		else
+			free(jobs[i].key);
+		if (jobs[i].tree || jobs[i].hit)
+			print_result(&jobs[i].res);
+		else if (jobs[i].bad >= 0)
+			report_bad(jobs[i].bad);
+		else
+			printf("Out of memory\n");
+		destroy_tree(jobs[i].tree);
+	}
+}
+
+/*
+** Elabora buf[0..len), che deve essere scrivibile: ogni '\n' viene
+** sostituito da '\0' così le righe diventano stringhe C senza copie.
+** L'ultima riga, se non termina con '\n', usa buf[len] che il
+** chiamante garantisce scrivibile.
+*/
+static int	run_lines(t_batch *b, char *buf, size_t len)
+{
+	t_job	*jobs = malloc(BATCH_CHUNK * sizeof(*jobs));
+	size_t	n = 0;
+	char	*line = buf;
+	char	*end = buf + len;
+
+	if (!jobs)
+		return (1);
+	while (line < end)
+	{
+		char	*nl = memchr(line, '\n', end - line);
+
+		if (!nl)
+			nl = end;
+		*nl = '\0';
+		b->lineno++;
+		if (b->lint)
+		{
+			if (vbc_diagnose(&b->ctx[0], line, &b->diags) < 0)
+				printf("%zu: Out of memory\n", b->lineno);
+			diag_print(&b->diags, b->lineno);
+			line = nl + 1;
+			continue ;
+		}
+		jobs[n] = (t_job){.line = line};
+		line = nl + 1;
+		if (++n == BATCH_CHUNK || line >= end)
+		{
+			run_chunk(b, jobs, n);
+			flush_chunk(b, jobs, n);
+			n = 0;
+		}
+	}
+	free(jobs);
+	return (0);
+}
+
+/*
+** Legge tutto stdin in un buffer che cresce raddoppiando,
+** lasciando sempre un byte libero per il terminatore.
+*/
+static char	*slurp_fd(int fd, size_t *len)
+{
+	size_t	cap = 1 << 16;
+	char	*buf = malloc(cap);
+	ssize_t	r;
+
+	*len = 0;
+	while (buf)
+	{
+		if (*len + 1 >= cap)
+		{
+			char	*tmp = realloc(buf, cap * 2);
+			if (!tmp)
+				return (free(buf), NULL);
+			buf = tmp;
+			cap *= 2;
+		}
+		r = read(fd, buf + *len, cap - *len - 1);
+		if (r <= 0)
+			return (r < 0 ? (free(buf), NULL) : buf);
+		*len += r;
+	}
+	return (NULL);
+}
+
+static int	run_input(t_batch *b, const char *path)
+{
+	struct stat	st;
+	char		*buf;
+	size_t		len;
+	int			is_stdin = !strcmp(path, "-");
+	int			fd;
+	int			ret;
+
+	fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+	if (fd == -1)
+		return (1);
+	if (is_stdin || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+		|| st.st_size % sysconf(_SC_PAGESIZE) == 0)
+	{
+		buf = slurp_fd(fd, &len);
+		if (!is_stdin)
+			close(fd);
+		if (!buf)
+			return (1);
+		ret = run_lines(b, buf, len);
+		return (free(buf), ret);
+	}
+	len = st.st_size;
+	buf = mmap(NULL, len + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED)
+		return (1);
+	madvise(buf, len, MADV_SEQUENTIAL);
+	ret = run_lines(b, buf, len);
+	munmap(buf, len + 1);
+	return (ret);
+}
+
+/*
+** run_batch: path == "-" legge da stdin, altrimenti il file viene
+** mappato con mmap MAP_PRIVATE (le scritture dei '\0' restano private
+** al processo). Si mappa un byte in più della dimensione del file così
+** anche l'ultima riga senza '\n' ha spazio per il terminatore (se la
+** dimensione è multiplo della pagina il byte extra cade in una pagina
+** non mappata, quindi in quel caso il file si legge in un buffer come
+** stdin, senza toccare il fd 0).
+** cache > 0 attiva la cache con quella capacità e a fine elaborazione
+** stampa su stderr hit, miss ed eliminazioni. lint attiva -l.
+** Ritorna 0 in caso di successo, 1 se il file non è leggibile.
+*/
+int	run_batch(const char *path, t_mode mode, int threads, size_t cache,
+		int lint)
+{
+	t_batch	b = {.mode = mode, .threads = threads < 1 ? 1 : threads,
+		.lint = lint};
+	int		ret;
+
+	b.ctx = calloc(b.threads, sizeof(*b.ctx));
+	if (!b.ctx)
+		return (1);
+	for (int t = 0; t < b.threads; t++)
+		b.ctx[t].mode = mode;
+	if (cache && cache_init(&b.cache, cache))
+		return (free(b.ctx), 1);
+	setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+	ret = run_input(&b, path);
+	if (cache)
+	{
+		fflush(stdout);
+		fprintf(stderr, "cache: %zu hits, %zu misses, %zu evictions\n",
+			b.cache.hits, b.cache.misses, b.cache.evictions);
+		cache_destroy(&b.cache);
+	}
+	diag_free(&b.diags);
+	for (int t = 0; t < b.threads; t++)
+		vbc_ctx_destroy(&b.ctx[t]);
+	free(b.ctx);
+	return (ret);
+}
@@ -0,0 +1,250 @@
+#include "vbc.h"
+
+/*
+** Sotto questa soglia (in limb) la moltiplicazione scolastica O(n*m)
+** è più veloce di Karatsuba, che paga allocazioni e somme extra.
+*/
+#define KARATSUBA_MIN 32
+
+static size_t	trim(const uint32_t *a, size_t n)
+{
+	while (n > 0 && a[n - 1] == 0)
+		n--;
+	return (n);
+}
+
+/*
+** r[0..n) += b[0..nb), propagando il riporto fino alla fine di r.
+** Il chiamante garantisce che il risultato stia in n limb.
+*/
+static void	add_into(uint32_t *r, size_t n, const uint32_t *b, size_t nb)
+{
+	uint32_t	carry = 0;
+	size_t		i;
+
+	for (i = 0; i < nb || (carry && i < n); i++)
+	{
+		uint32_t	cur = r[i] + carry + (i < nb ? b[i] : 0);
+		carry = cur >= BIG_BASE;
+		r[i] = carry ? cur - BIG_BASE : cur;
+	}
+}
+
+/*
+** r[0..n) -= b[0..nb), con r >= b garantito dal chiamante.
+*/
+static void	sub_from(uint32_t *r, size_t n, const uint32_t *b, size_t nb)
+{
+	uint32_t	borrow = 0;
+	size_t		i;
+
+	for (i = 0; i < nb || (borrow && i < n); i++)
+	{
+		uint32_t	sub = borrow + (i < nb ? b[i] : 0);
+		borrow = r[i] < sub;
+		r[i] = borrow ? r[i] + BIG_BASE - sub : r[i] - sub;
+	}
+}
+
+/*
+** Moltiplicazione scolastica: r[0..na+nb) deve essere azzerato.
+** a[i]*b[j] < 10^18, quindi cur sta comodamente in 64 bit.
+*/
+static void	mul_school(uint32_t *r, const uint32_t *a, size_t na,
+		const uint32_t *b, size_t nb)
+{
+	for (size_t i = 0; i < na; i++)
+	{
+		uint64_t	carry = 0;
+		size_t		j;
+
+		if (a[i] == 0)
+			continue ;
+		for (j = 0; j < nb; j++)
+		{
+			uint64_t	cur = r[i + j] + (uint64_t)a[i] * b[j] + carry;
+			r[i + j] = cur % BIG_BASE;
+			carry = cur / BIG_BASE;
+		}
+		for (; carry; j++)
+		{
+			uint64_t	cur = r[i + j] + carry;
+			r[i + j] = cur % BIG_BASE;
+			carry = cur / BIG_BASE;
+		}
+	}
+}
+
+/*
+** mul_rec: r[0..na+nb) = a * b, con r azzerato e na >= nb.
+**   - operandi piccoli: mul_school
+**   - b molto più corto di a: si spezza solo a (a0*b + a1*b*B^m)
+**   - altrimenti Karatsuba:
+**       z0 = a0*b0, z2 = a1*b1, z1 = (a0+a1)*(b0+b1) - z0 - z2
+**       a*b = z0 + z1*B^m + z2*B^2m
+**     z0 e z2 vengono scritti direttamente nelle loro zone di r,
+**     z1 in un buffer temporaneo che poi si somma a r+m.
+** Ritorna 0, oppure -1 se fallisce un'allocazione.
+*/
+static int	mul_rec(uint32_t *r, const uint32_t *a, size_t na,
+		const uint32_t *b, size_t nb)
+{
+	size_t		m;
+	uint32_t	*tmp;
+	size_t		nsa;
+	size_t		nsb;
+
+	if (na < nb)
+		return (mul_rec(r, b, nb, a, na));
+	if (nb < KARATSUBA_MIN)
+		return (mul_school(r, a, na, b, nb), 0);
+	m = na / 2;
+	if (nb <= m)
+	{
+		tmp = calloc(na - m + nb, sizeof(*tmp));
+		if (!tmp || mul_rec(r, a, m, b, nb)
+			|| mul_rec(tmp, a + m, na - m, b, nb))
+			return (free(tmp), -1);
+		add_into(r + m, na + nb - m, tmp, trim(tmp, na - m + nb));
+		return (free(tmp), 0);
+	}
+	nsa = na - m + 1;
+	nsb = (nb - m > m ? nb - m : m) + 1;
+	tmp = calloc(nsa + nsb + nsa + nsb, sizeof(*tmp));
+	if (!tmp)
+		return (-1);
+	memcpy(tmp, a, m * sizeof(*a));
+	add_into(tmp, nsa, a + m, na - m);
+	memcpy(tmp + nsa, b, m * sizeof(*b));
+	add_into(tmp + nsa, nsb, b + m, nb - m);
+	if (mul_rec(r, a, m, b, m)
+		|| mul_rec(r + 2 * m, a + m, na - m, b + m, nb - m)
+		|| mul_rec(tmp + nsa + nsb, tmp, trim(tmp, nsa),
+			tmp + nsa, trim(tmp + nsa, nsb)))
+		return (free(tmp), -1);
+	sub_from(tmp + nsa + nsb, nsa + nsb, r, trim(r, 2 * m));
+	sub_from(tmp + nsa + nsb, nsa + nsb, r + 2 * m,
+		trim(r + 2 * m, na + nb - 2 * m));
+	add_into(r + m, na + nb - m, tmp + nsa + nsb,
+		trim(tmp + nsa + nsb, nsa + nsb));
+	free(tmp);
+	return (0);
+}
+
+/*
+** Sostituisce il buffer di dst con limb (già calcolato) di lunghezza n.
+*/
+static void	big_replace(t_big *dst, uint32_t *limb, size_t n)
+{
+	free(dst->limb);
+	dst->limb = limb;
+	dst->len = trim(limb, n);
+}
+
+/*
+** Un uint64_t (< 1.9 * 10^19) sta sempre in 3 limb.
+*/
+int	big_set(t_big *dst, uint64_t v)
+{
+	uint32_t	*limb = calloc(3, sizeof(*limb));
+
+	if (!limb)
+		return (-1);
+	for (int i = 0; i < 3; i++, v /= BIG_BASE)
+		limb[i] = v % BIG_BASE;
+	big_replace(dst, limb, 3);
+	return (0);
+}
+
+/*
+** dst = numero scritto con le len cifre decimali di s (zeri iniziali
+** ammessi): blocchi di 9 cifre dalla fine, uno per limb.
+*/
+int	big_from_str(t_big *dst, const char *s, size_t len)
+{
+	size_t		n = (len + 8) / 9;
+	uint32_t	*limb = calloc(n ? n : 1, sizeof(*limb));
+	size_t		end = len;
+
+	if (!limb)
+		return (-1);
+	for (size_t i = 0; i < n; i++, end -= 9)
+		for (size_t k = end > 9 ? end - 9 : 0; k < end; k++)
+			limb[i] = limb[i] * 10 + (s[k] - '0');
+	big_replace(dst, limb, n);
+	return (0);
+}
+
+/*
+** dst = a + b. dst può coincidere con a o b.
+*/
+int	big_add(t_big *dst, const t_big *a, const t_big *b)
+{
+	size_t		n = (a->len > b->len ? a->len : b->len) + 1;
+	uint32_t	*limb = calloc(n, sizeof(*limb));
+
+	if (!limb)
+		return (-1);
+	if (a->len)
+		memcpy(limb, a->limb, a->len * sizeof(*limb));
+	add_into(limb, n, b->limb, b->len);
+	big_replace(dst, limb, n);
+	return (0);
+}
+
+/*
+** dst = a * b. dst può coincidere con a o b.
+*/
+int	big_mul(t_big *dst, const t_big *a, const t_big *b)
+{
+	size_t		n = a->len + b->len;
+	uint32_t	*limb = calloc(n ? n : 1, sizeof(*limb));
+
+	if (!limb)
+		return (-1);
+	if (a->len && b->len && mul_rec(limb, a->limb, a->len, b->limb, b->len))
+		return (free(limb), -1);
+	big_replace(dst, limb, n);
+	return (0);
+}
+
+/*
+** dst = copia di src (dst deve essere vuoto o già allocato).
+*/
+int	big_copy(t_big *dst, const t_big *src)
+{
+	uint32_t	*limb;
+
+	if (src->len == 0)
+		return (big_free(dst), 0);
+	limb = malloc(src->len * sizeof(*limb));
+	if (!limb)
+		return (-1);
+	memcpy(limb, src->limb, src->len * sizeof(*limb));
+	big_replace(dst, limb, src->len);
+	return (0);
+}
+
+/*
+** Stampa in decimale: il limb più alto senza zeri iniziali,
+** gli altri sempre su 9 cifre.
+*/
+void	big_print(const t_big *n)
+{
+	if (n->len == 0)
+	{
+		printf("0\n");
+		return ;
+	}
+	printf("%u", n->limb[n->len - 1]);
+	for (size_t i = n->len - 1; i > 0; i--)
+		printf("%09u", n->limb[i - 1]);
+	printf("\n");
+}
+
+void	big_free(t_big *n)
+{
+	free(n->limb);
+	n->limb = NULL;
+	n->len = 0;
+}
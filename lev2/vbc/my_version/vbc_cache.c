@@ -0,0 +1,193 @@
+#include "vbc.h"
+
+/*
+** Cache delle espressioni: testo normalizzato -> risultato. Le
+** espressioni di vbc non hanno variabili, quindi sono tutte costanti:
+** basta il risultato, l'albero non serve più dopo la valutazione.
+**
+**   - tabella hash con liste di collisione (FNV-1a sulla chiave)
+**   - lista doppiamente collegata in ordine d'uso: head è la voce usata
+**     più di recente, tail quella da eliminare quando la cache è piena
+**   - un mutex protegge tutto, così la cache è condivisa tra i thread
+*/
+
+static size_t	hash_key(const char *key, size_t len)
+{
+	size_t	h = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ (unsigned char)key[i]) * 1099511628211ULL;
+	return (h);
+}
+
+/*
+** normalize: copia src in dst togliendo gli spazi. Tra due cifre
+** separate da spazi ne resta uno, perché "1 2" (errore) e "12" sono
+** espressioni diverse. dst deve avere spazio per strlen(src) + 1.
+** Ritorna la lunghezza della chiave.
+*/
+size_t	normalize(const char *src, char *dst)
+{
+	size_t	n = 0;
+	int		gap = 0;
+
+	for (; *src; src++)
+	{
+		if (*src == ' ' || *src == '\t' || *src == '\n')
+		{
+			gap = 1;
+			continue ;
+		}
+		if (gap && n && isdigit((unsigned char)dst[n - 1])
+			&& isdigit((unsigned char)*src))
+			dst[n++] = ' ';
+		gap = 0;
+		dst[n++] = *src;
+	}
+	dst[n] = '\0';
+	return (n);
+}
+
+int	cache_init(t_cache *c, size_t cap)
+{
+	*c = (t_cache){.cap = cap};
+	c->nbuckets = 16;
+	while (c->nbuckets < cap * 2)
+		c->nbuckets *= 2;
+	c->buckets = calloc(c->nbuckets, sizeof(*c->buckets));
+	if (!c->buckets)
+		return (-1);
+	pthread_mutex_init(&c->lock, NULL);
+	return (0);
+}
+
+static void	lru_unlink(t_cache *c, t_centry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		c->head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		c->tail = e->prev;
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+static void	lru_push_front(t_cache *c, t_centry *e)
+{
+	e->next = c->head;
+	if (c->head)
+		c->head->prev = e;
+	c->head = e;
+	if (!c->tail)
+		c->tail = e;
+}
+
+static void	free_entry(t_centry *e)
+{
+	big_free(&e->res.big);
+	free(e->key);
+	free(e);
+}
+
+static void	evict_tail(t_cache *c)
+{
+	t_centry	*e = c->tail;
+	t_centry	**pp = &c->buckets[e->hash & (c->nbuckets - 1)];
+
+	while (*pp != e)
+		pp = &(*pp)->hnext;
+	*pp = e->hnext;
+	lru_unlink(c, e);
+	free_entry(e);
+	c->size--;
+	c->evictions++;
+}
+
+static t_centry	*find(t_cache *c, const char *key, size_t len, size_t h)
+{
+	t_centry	*e = c->buckets[h & (c->nbuckets - 1)];
+
+	while (e && (e->hash != h || e->len != len || memcmp(e->key, key, len)))
+		e = e->hnext;
+	return (e);
+}
+
+/*
+** cache_get: se la chiave è presente copia il risultato in *res
+** (il bignum viene duplicato: il chiamante lo libera come sempre con
+** print_result) e ritorna 1; altrimenti ritorna 0.
+*/
+int	cache_get(t_cache *c, const char *key, size_t len, t_result *res)
+{
+	size_t		h = hash_key(key, len);
+	t_centry	*e;
+	int			found = 0;
+
+	pthread_mutex_lock(&c->lock);
+	e = find(c, key, len, h);
+	if (e)
+	{
+		lru_unlink(c, e);
+		lru_push_front(c, e);
+		*res = e->res;
+		res->big = (t_big){0};
+		found = big_copy(&res->big, &e->res.big) == 0;
+	}
+	c->hits += found;
+	c->misses += !found;
+	pthread_mutex_unlock(&c->lock);
+	return (found);
+}
+
+/*
+** cache_put: inserisce key -> res. La cache diventa proprietaria di key
+** (allocata con malloc) e si tiene una copia di res. Se la chiave c'è
+** già o l'inserimento fallisce, key viene liberata subito. Quando la
+** cache è piena elimina la voce meno usata.
+*/
+void	cache_put(t_cache *c, char *key, size_t len, const t_result *res)
+{
+	size_t		h = hash_key(key, len);
+	t_centry	*e;
+
+	pthread_mutex_lock(&c->lock);
+	e = NULL;
+	if (c->cap && !find(c, key, len, h))
+		e = calloc(1, sizeof(*e));
+	if (e && big_copy(&e->res.big, &res->big) == 0)
+	{
+		t_big	big = e->res.big;
+
+		*e = (t_centry){.key = key, .len = len, .hash = h, .res = *res};
+		e->res.big = big;
+		if (c->size == c->cap)
+			evict_tail(c);
+		e->hnext = c->buckets[h & (c->nbuckets - 1)];
+		c->buckets[h & (c->nbuckets - 1)] = e;
+		lru_push_front(c, e);
+		c->size++;
+		key = NULL;
+	}
+	else
+		free(e);
+	pthread_mutex_unlock(&c->lock);
+	free(key);
+}
+
+void	cache_destroy(t_cache *c)
+{
+	t_centry	*e = c->head;
+
+	while (e)
+	{
+		t_centry	*next = e->next;
+		free_entry(e);
+		e = next;
+	}
+	free(c->buckets);
+	pthread_mutex_destroy(&c->lock);
+	*c = (t_cache){0};
+}
@@ -0,0 +1,55 @@
+#include "vbc.h"
+
+/*
+** Aggiunge una diagnostica. Se l'allocazione fallisce la diagnostica
+** viene persa ma l'analisi continua: meglio una lista incompleta che
+** interrompere il lint.
+*/
+void	diag_push(t_diags *d, size_t pos, int c)
+{
+	if (d->len == d->cap)
+	{
+		size_t	cap = d->cap ? d->cap * 2 : 8;
+		t_diag	*tmp = realloc(d->v, cap * sizeof(*tmp));
+		if (!tmp)
+			return ;
+		d->v = tmp;
+		d->cap = cap;
+	}
+	d->v[d->len++] = (t_diag){.pos = pos, .c = c};
+}
+
+/*
+** Stampa le diagnostiche come "riga:colonna: messaggio" (colonne da 1),
+** oppure solo "colonna: messaggio" se line == 0. I messaggi sono gli
+** stessi di report_bad().
+*/
+void	diag_print(const t_diags *d, size_t line)
+{
+	for (size_t i = 0; i < d->len; i++)
+	{
+		if (line)
+			printf("%zu:", line);
+		printf("%zu: ", d->v[i].pos + 1);
+		report_bad(d->v[i].c);
+	}
+}
+
+/*
+** Messaggio per un codice *bad di vbc_parse (o una diagnostica):
+** unexpected() per un carattere, "Constant too large" per
+** BAD_TOO_LARGE.
+*/
+void	report_bad(int bad)
+{
+	if (bad == BAD_TOO_LARGE)
+		printf("Constant too large\n");
+	else
+		unexpected(bad);
+}
+
+void	diag_free(t_diags *d)
+{
+	free(d->v);
+	*d = (t_diags){0};
+}
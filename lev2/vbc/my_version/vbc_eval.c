@@ -0,0 +1,103 @@
+#include "vbc.h"
+
+/*
+** eval_tree: valutazione con int, identica a quella di given.c.
+** Un overflow qui è comportamento indefinito: per risultati grandi
+** usare eval_checked() o eval_big().
+*/
+int	eval_tree(node *tree)
+{
+	switch (tree->type)
+	{
+		case ADD:
+			return (eval_tree(tree->l) + eval_tree(tree->r));
+		case MULTI:
+			return (eval_tree(tree->l) * eval_tree(tree->r));
+		case VAL:
+			return ((int)tree->val);
+	}
+	return (0);
+}
+
+/*
+** eval_checked: valuta su 64 bit usando i builtin di gcc/clang che
+** segnalano l'overflow invece di lasciarlo indefinito.
+** Ritorna 0 e scrive il risultato in *out, -1 in caso di overflow.
+*/
+int	eval_checked(node *tree, long long *out)
+{
+	long long	l;
+	long long	r;
+
+	if (tree->type == VAL)
+		return (*out = tree->val, 0);
+	if (eval_checked(tree->l, &l) || eval_checked(tree->r, &r))
+		return (-1);
+	if (tree->type == ADD)
+		return (__builtin_add_overflow(l, r, out) ? -1 : 0);
+	return (__builtin_mul_overflow(l, r, out) ? -1 : 0);
+}
+
+/*
+** eval_big: valuta a precisione arbitraria. *out deve essere
+** inizializzato a {0}; il chiamante lo libera con big_free().
+** Ritorna 0 in caso di successo, -1 se fallisce un'allocazione.
+*/
+int	eval_big(node *tree, t_big *out)
+{
+	t_big	l = {0};
+	t_big	r = {0};
+	int		ret;
+
+	if (tree->type == VAL && tree->big.len)
+		return (big_copy(out, &tree->big));
+	if (tree->type == VAL)
+		return (big_set(out, tree->val));
+	ret = eval_big(tree->l, &l);
+	if (!ret)
+		ret = eval_big(tree->r, &r);
+	if (!ret && tree->type == ADD)
+		ret = big_add(out, &l, &r);
+	else if (!ret)
+		ret = big_mul(out, &l, &r);
+	big_free(&l);
+	big_free(&r);
+	return (ret);
+}
+
+/*
+** eval_result: valuta l'albero nella modalità scelta salvando il
+** risultato in *res, senza stampare. Separare valutazione e stampa
+** permette alla modalità batch di valutare in parallelo e stampare
+** poi nell'ordine delle righe.
+*/
+void	eval_result(node *tree, t_mode mode, t_result *res)
+{
+	*res = (t_result){.mode = mode};
+	if (mode == MODE_CHECKED)
+		res->err = eval_checked(tree, &res->ll) ? RES_OVERFLOW : 0;
+	else if (mode == MODE_BIG)
+		res->err = eval_big(tree, &res->big) ? RES_NOMEM : 0;
+	else
+		res->i = eval_tree(tree);
+}
+
+/*
+** print_result: stampa il risultato (o l'errore) e libera l'eventuale
+** bignum. Ritorna 0 in caso di successo, 1 in caso di errore.
+*/
+int	print_result(t_result *res)
+{
+	if (res->err == RES_OVERFLOW)
+		printf("Overflow\n");
+	else if (res->err)
+		printf("Out of memory\n");
+	else if (res->mode == MODE_CHECKED)
+		printf("%lld\n", res->ll);
+	else if (res->mode == MODE_BIG)
+		big_print(&res->big);
+	else
+		printf("%d\n", res->i);
+	big_free(&res->big);
+	return (res->err != 0);
+}
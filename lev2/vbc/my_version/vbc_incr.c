@@ -0,0 +1,168 @@
+#include "vbc_lib.h"
+
+/*
+** Rivalutazione incrementale: ogni nodo tiene in cache il valore del
+** proprio sottoalbero e un puntatore al padre. Dopo aver cambiato una
+** foglia basta ricalcolare il cammino foglia -> radice usando i valori
+** in cache dei fratelli: O(profondità) invece di O(n). Attenzione: il
+** parser costruisce catene sinistre, quindi su una somma piatta
+** a+b+c+... la profondità è il numero di termini e aggiornare la prima
+** foglia costa comunque O(n) (l'ultima O(1)).
+**
+** Le visite sono iterative (come destroy_tree e flatten): una catena
+** di milioni di nodi esaurirebbe lo stack con la ricorsione.
+**
+** Supporta MODE_INT (cache troncata a 32 bit come eval_tree) e
+** MODE_CHECKED (cache_err segnala un overflow nel sottoalbero).
+** Per MODE_BIG tenere un bignum in ogni nodo costerebbe troppa memoria:
+** incr_prepare ritorna -1 e si usa eval_result.
+*/
+
+/*
+** Ricalcola la cache di n a partire da quella dei figli.
+*/
+static void	refresh(node *n, t_mode mode)
+{
+	long long	l;
+	long long	r;
+
+	if (n->type == VAL)
+	{
+		n->cache = mode == MODE_INT ? (int)n->val : n->val;
+		n->cache_err = 0;
+		return ;
+	}
+	l = n->l->cache;
+	r = n->r->cache;
+	n->cache_err = n->l->cache_err || n->r->cache_err;
+	if (mode == MODE_INT && n->type == ADD)
+		n->cache = (int)((unsigned)l + (unsigned)r);
+	else if (mode == MODE_INT)
+		n->cache = (int)((unsigned)l * (unsigned)r);
+	else if (n->type == ADD)
+		n->cache_err |= __builtin_add_overflow(l, r, &n->cache);
+	else
+		n->cache_err |= __builtin_mul_overflow(l, r, &n->cache);
+}
+
+/*
+** incr_prepare: collega i padri e riempie le cache di tutto l'albero
+** (una visita completa, da fare una volta sola dopo il parsing).
+** Visita in post-ordine senza stack: scendendo si collega il padre del
+** figlio, così per risalire basta n->parent; prev (il nodo da cui si
+** arriva) dice se si scende, si torna dal sinistro o dal destro.
+** Ritorna 0, oppure -1 se la modalità non è supportata.
+*/
+int	incr_prepare(node *tree, t_mode mode)
+{
+	node	*n = tree;
+	node	*prev = NULL;
+	node	*next;
+
+	if (mode == MODE_BIG)
+		return (-1);
+	tree->parent = NULL;
+	while (n)
+	{
+		if (n->type != VAL && prev == n->parent)
+			next = n->l;
+		else if (n->type != VAL && prev == n->l)
+			next = n->r;
+		else
+			next = NULL;
+		if (next)
+			next->parent = n;
+		else
+			refresh(n, mode);
+		prev = n;
+		n = next ? next : n->parent;
+	}
+	return (0);
+}
+
+/*
+** incr_set_leaf: cambia il valore di una foglia e aggiorna solo le
+** cache dei suoi antenati.
+*/
+void	incr_set_leaf(node *leaf, long long val, t_mode mode)
+{
+	leaf->val = val;
+	for (node *n = leaf; n; n = n->parent)
+		refresh(n, mode);
+}
+
+/*
+** incr_result: legge il risultato dalla cache della radice, nello
+** stesso formato di eval_result.
+*/
+void	incr_result(node *tree, t_mode mode, t_result *res)
+{
+	*res = (t_result){.mode = mode};
+	if (tree->cache_err)
+		res->err = RES_OVERFLOW;
+	res->ll = tree->cache;
+	res->i = (int)tree->cache;
+}
+
+static int	push_node(node ***stack, size_t *len, size_t *cap, node *n)
+{
+	if (*len == *cap)
+	{
+		size_t	new_cap = *cap ? *cap * 2 : 64;
+		node	**tmp = realloc(*stack, new_cap * sizeof(*tmp));
+		if (!tmp)
+			return (-1);
+		*stack = tmp;
+		*cap = new_cap;
+	}
+	(*stack)[(*len)++] = n;
+	return (0);
+}
+
+/*
+** leaf_at: ritorna la foglia numero index (da 0, da sinistra a destra),
+** NULL se l'albero ha meno foglie (o se fallisce un'allocazione).
+** *index viene decrementato delle foglie saltate.
+** Scende lungo il figlio sinistro mettendo i figli destri su uno stack
+** esplicito, che cresce con la profondità (sullo heap, non sullo stack
+** del thread).
+*/
+node	*leaf_at(node *tree, size_t *index)
+{
+	node	**stack = NULL;
+	size_t	len = 0;
+	size_t	cap = 0;
+	node	*n = tree;
+
+	while (n)
+	{
+		for (; n->type != VAL; n = n->l)
+			if (push_node(&stack, &len, &cap, n->r))
+				return (free(stack), NULL);
+		if ((*index)-- == 0)
+			break ;
+		n = len ? stack[--len] : NULL;
+	}
+	free(stack);
+	return (n);
+}
+
+// int	main(void)
+// {
+// 	char		expr[] = "1+2*3+(4*5+6)";
+// 	int			bad;
+// 	size_t		idx = 3;
+// 	t_vbc_ctx	ctx = {0};
+// 	node		*tree = vbc_parse(&ctx, expr, &bad);
+// 	t_result	res;
+
+// 	incr_prepare(tree, MODE_INT);
+// 	incr_result(tree, MODE_INT, &res);
+// 	print_result(&res);						// 33
+// 	incr_set_leaf(leaf_at(tree, &idx), 10, MODE_INT);
+// 	incr_result(tree, MODE_INT, &res);
+// 	print_result(&res);						// 63
+// 	destroy_tree(tree);
+// 	vbc_ctx_destroy(&ctx);
+// 	return (0);
+// }
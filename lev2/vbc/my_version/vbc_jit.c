@@ -0,0 +1,224 @@
+#include "vbc.h"
+#include <sys/mman.h>
+
+/*
+** JIT: traduce l'albero in codice macchina x86-64 scritto in una pagina
+** mmap, poi resa eseguibile con mprotect (mai scrivibile ed eseguibile
+** insieme). Utile quando la stessa espressione va valutata molte volte.
+**
+** Il codice generato ha firma int f(long long *out):
+**   - il risultato si accumula in rax; il figlio destro, se non è una
+**     costante, viene calcolato dopo aver salvato il sinistro sullo stack
+**   - MODE_INT usa istruzioni a 32 bit (eax), come eval_tree
+**   - MODE_CHECKED usa istruzioni a 64 bit seguite da jo verso
+**     un'uscita che ripristina rsp da rbp e ritorna -1
+** MODE_BIG e le architetture diverse da x86-64 non sono supportate:
+** jit_compile ritorna NULL e il chiamante usa eval_result().
+*/
+#if defined(__x86_64__)
+
+/* byte massimi emessi per nodo: push + mov + pop + imul + jo */
+# define JIT_NODE_MAX 24
+
+/*
+** spine: stack dei nodi della spina sinistra in corso di generazione
+** (sullo heap, al più un elemento per nodo: vedi gen).
+*/
+typedef struct s_emit {
+	uint8_t	*p;
+	uint8_t	*fail;
+	t_mode	mode;
+	node	**spine;
+	size_t	len;
+}	t_emit;
+
+static void	emit(t_emit *e, const void *bytes, size_t n)
+{
+	memcpy(e->p, bytes, n);
+	e->p += n;
+}
+
+static void	emit_imm(t_emit *e, const void *op, size_t n, int32_t imm)
+{
+	emit(e, op, n);
+	emit(e, &imm, 4);
+}
+
+/*
+** jo rel32 verso l'uscita di overflow (solo MODE_CHECKED).
+*/
+static void	emit_jo(t_emit *e)
+{
+	int32_t	rel;
+
+	if (e->mode != MODE_CHECKED)
+		return ;
+	emit(e, "\x0f\x80", 2);
+	rel = (int32_t)(e->fail - (e->p + 4));
+	emit(e, &rel, 4);
+}
+
+/*
+** Gli immediati di add/imul sono a 32 bit con estensione di segno.
+** In MODE_INT il troncamento a 32 bit è voluto (come il cast di
+** eval_tree), in MODE_CHECKED le costanti più grandi passano da rcx.
+*/
+static int	fits_imm32(long long v)
+{
+	return (v >= INT32_MIN && v <= INT32_MAX);
+}
+
+static void	gen_val(t_emit *e, node *n)
+{
+	int	wide = e->mode == MODE_CHECKED;
+
+	if (wide && !fits_imm32(n->val))
+	{
+		emit(e, "\x48\xb8", 2);						/* mov rax, imm64 */
+		emit(e, &n->val, 8);
+	}
+	else if (wide)
+		emit_imm(e, "\x48\xc7\xc0", 3, n->val);		/* mov rax, imm32 */
+	else
+		emit_imm(e, "\xb8", 1, n->val);				/* mov eax, imm32 */
+}
+
+/*
+** Iterativa lungo il figlio sinistro (come destroy_tree e flatten):
+** scende la spina mettendo i nodi su e->spine, genera la foglia in
+** fondo e poi, risalendo, applica a rax il figlio destro di ogni nodo.
+** La ricorsione resta solo sui figli destri non costanti. Ogni
+** chiamata usa la parte di e->spine sopra quella del chiamante.
+*/
+static void	gen(t_emit *e, node *n)
+{
+	int		wide = e->mode == MODE_CHECKED;
+	size_t	base = e->len;
+
+	for (; n->type != VAL; n = n->l)
+		e->spine[e->len++] = n;
+	gen_val(e, n);
+	while (e->len > base)
+	{
+		n = e->spine[--e->len];
+		if (n->r->type == VAL && (!wide || fits_imm32(n->r->val)))
+		{
+			if (n->type == ADD)						/* add rax, imm32 */
+				emit_imm(e, "\x48\x05" + !wide, 1 + wide, n->r->val);
+			else									/* imul rax, rax, imm32 */
+				emit_imm(e, "\x48\x69\xc0" + !wide, 2 + wide, n->r->val);
+			emit_jo(e);
+			continue ;
+		}
+		emit(e, "\x50", 1);							/* push rax */
+		gen(e, n->r);
+		emit(e, "\x48\x89\xc1" + !wide, 2 + wide);	/* mov rcx, rax */
+		emit(e, "\x58", 1);							/* pop rax */
+		if (n->type == ADD)
+			emit(e, "\x48\x01\xc8" + !wide, 2 + wide);/* add rax, rcx */
+		else										/* imul rax, rcx */
+			emit(e, "\x48\x0f\xaf\xc1" + !wide, 3 + wide);
+		emit_jo(e);
+	}
+}
+
+/*
+** Iterativa lungo il figlio sinistro, ricorsiva solo sul destro.
+*/
+static size_t	count_nodes(node *n)
+{
+	size_t	count = 1;
+
+	for (; n->type != VAL; n = n->l)
+		count += 1 + count_nodes(n->r);
+	return (count);
+}
+
+/*
+** Layout della pagina:
+**   [uscita overflow][prologo][corpo][epilogo]
+** L'uscita di overflow sta in testa così i jo hanno già il bersaglio.
+*/
+t_jit	*jit_compile(node *tree, t_mode mode)
+{
+	t_jit	*jit;
+	t_emit	e;
+	size_t	nodes;
+
+	if (mode == MODE_BIG)
+		return (NULL);
+	jit = calloc(1, sizeof(*jit));
+	if (!jit)
+		return (NULL);
+	jit->mode = mode;
+	nodes = count_nodes(tree);
+	jit->size = nodes * JIT_NODE_MAX + 64;
+	jit->code = mmap(NULL, jit->size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (jit->code == MAP_FAILED)
+		return (free(jit), NULL);
+	e = (t_emit){.p = jit->code, .fail = jit->code, .mode = mode,
+		.spine = malloc(nodes * sizeof(*e.spine))};
+	if (!e.spine)
+		return (jit_free(jit), NULL);
+	emit(&e, "\x48\x89\xec\x5d", 4);				/* mov rsp, rbp; pop rbp */
+	emit_imm(&e, "\xb8", 1, -1);					/* mov eax, -1 */
+	emit(&e, "\xc3", 1);							/* ret */
+	jit->entry = e.p;
+	emit(&e, "\x55\x48\x89\xe5", 4);				/* push rbp; mov rbp, rsp */
+	gen(&e, tree);
+	free(e.spine);
+	if (mode == MODE_INT)
+		emit(&e, "\x48\x63\xc0", 3);				/* movsxd rax, eax */
+	emit(&e, "\x48\x89\x07", 3);					/* mov [rdi], rax */
+	emit(&e, "\x31\xc0\x5d\xc3", 4);				/* xor eax, eax; pop rbp; ret */
+	if (mprotect(jit->code, jit->size, PROT_READ | PROT_EXEC) == -1)
+		return (jit_free(jit), NULL);
+	return (jit);
+}
+
+/*
+** Esegue il codice compilato e riempie *res come eval_result().
+*/
+void	jit_run(t_jit *jit, t_result *res)
+{
+	int			(*fn)(long long *);
+	long long	v = 0;
+
+	*res = (t_result){.mode = jit->mode};
+	*(void **)&fn = jit->entry;
+	if (fn(&v))
+		res->err = RES_OVERFLOW;
+	res->ll = v;
+	res->i = (int)v;
+}
+
+void	jit_free(t_jit *jit)
+{
+	if (!jit)
+		return ;
+	munmap(jit->code, jit->size);
+	free(jit);
+}
+
+#else
+
+t_jit	*jit_compile(node *tree, t_mode mode)
+{
+	(void)tree;
+	(void)mode;
+	return (NULL);
+}
+
+void	jit_run(t_jit *jit, t_result *res)
+{
+	(void)jit;
+	*res = (t_result){.err = RES_NOMEM};
+}
+
+void	jit_free(t_jit *jit)
+{
+	(void)jit;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "vbc.h"
+
+/*
+** Lexer: un'unica passata lineare sulla stringa che produce l'array di
+** token consumato dal parser. Ogni carattere viene classificato con una
+** tabella (niente catene di if per carattere); gli spazi vengono saltati
+** in blocco e i numeri di più cifre accumulati in un long long con
+** controllo dell'overflow. Un numero che non ci sta è un errore
+** (BAD_TOO_LARGE), tranne in MODE_BIG dove resta come testo (pos, len)
+** per il parser.
+*/
+enum e_class {
+	C_BAD,
+	C_SPACE,
+	C_DIGIT,
+	C_OP
+};
+
+static const unsigned char	g_class[256] = {
+	[' '] = C_SPACE, ['\t'] = C_SPACE, ['\n'] = C_SPACE,
+	['0'] = C_DIGIT, ['1'] = C_DIGIT, ['2'] = C_DIGIT, ['3'] = C_DIGIT,
+	['4'] = C_DIGIT, ['5'] = C_DIGIT, ['6'] = C_DIGIT, ['7'] = C_DIGIT,
+	['8'] = C_DIGIT, ['9'] = C_DIGIT,
+	['+'] = C_OP, ['*'] = C_OP, ['('] = C_OP, [')'] = C_OP
+};
+
+static int	push_token(t_tokens *t, t_token tok)
+{
+	if (t->len == t->cap)
+	{
+		size_t	cap = t->cap ? t->cap * 2 : 64;
+		t_token	*tmp = realloc(t->v, cap * sizeof(*tmp));
+		if (!tmp)
+			return (-1);
+		t->v = tmp;
+		t->cap = cap;
+	}
+	t->v[t->len++] = tok;
+	return (0);
+}
+
+static int	op_type(char c)
+{
+	if (c == '+')
+		return (T_PLUS);
+	if (c == '*')
+		return (T_STAR);
+	if (c == '(')
+		return (T_LPAREN);
+	return (T_RPAREN);
+}
+
+/*
+** Errore lessicale: senza diags ci si ferma (ritorna 1 con *bad),
+** con diags lo si registra e il chiamante prosegue (ritorna 0).
+*/
+static int	lex_error(t_token *tok, int c, int *bad, t_diags *diags)
+{
+	if (!diags)
+		return (*bad = c, 1);
+	diag_push(diags, tok->pos, c);
+	tok->reported = 1;
+	return (0);
+}
+
+/*
+** tokenize: riempie t (riusando il suo buffer, len viene azzerato)
+** con i token di str seguiti da T_END.
+** Ritorna 0 se tutto va bene, 1 con *bad = carattere non valido (o
+** BAD_TOO_LARGE per un numero che non sta in un long long, fuori da
+** MODE_BIG), -1 se fallisce un'allocazione. Se diags non è NULL gli
+** errori vengono registrati lì e il carattere non valido o il numero
+** troppo grande diventano un numero 0 con reported = 1, così il parser
+** non segnala di nuovo un fattore mancante né, se il token è in eccesso
+** ("3 a 4"), la stessa posizione una seconda volta.
+*/
+int	tokenize(const char *str, t_tokens *t, t_mode mode, int *bad,
+		t_diags *diags)
+{
+	const unsigned char	*p = (const unsigned char *)str;
+
+	t->len = 0;
+	while (*p)
+	{
+		unsigned char	cls = g_class[*p];
+		t_token			tok = {.c = *p, .pos = (const char *)p - str};
+
+		if (cls == C_SPACE)
+		{
+			while (g_class[*++p] == C_SPACE)
+				;
+			continue ;
+		}
+		if (cls == C_BAD)
+		{
+			if (lex_error(&tok, *p++, bad, diags))
+				return (1);
+			tok.type = T_NUM;
+		}
+		else if (cls == C_DIGIT)
+		{
+			tok.type = T_NUM;
+			for (; g_class[*p] == C_DIGIT; p++)
+				if (!tok.big
+					&& (__builtin_mul_overflow(tok.val, 10, &tok.val)
+						|| __builtin_add_overflow(tok.val, *p - '0', &tok.val)))
+					tok.big = 1;
+			tok.len = (const char *)p - str - tok.pos;
+			if (tok.big)
+				tok.val = 0;
+			if (tok.big && mode != MODE_BIG
+				&& lex_error(&tok, BAD_TOO_LARGE, bad, diags))
+				return (1);
+			if (mode != MODE_BIG)
+				tok.big = 0;
+		}
+		else
+			tok.type = op_type(*p++);
+		if (push_token(t, tok))
+			return (-1);
+	}
+	return (push_token(t, (t_token){.type = T_END,
+			.pos = (const char *)p - str}));
+}
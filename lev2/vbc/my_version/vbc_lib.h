@@ -0,0 +1,49 @@
+#ifndef VBC_LIB_H
+#define VBC_LIB_H
+
+#include "vbc.h"
+
+/*
+** API rientrante di vbc: tutto lo stato del parser vive in un
+** t_vbc_ctx passato a ft_sum/ft_product/ft_factor, niente globali.
+** Un contesto per thread permette di analizzare in parallelo; lo
+** stesso contesto si riusa tra una chiamata e l'altra (il buffer dei
+** token non viene riallocato).
+**
+**   - mode: modalità numerica; in MODE_BIG i letterali che non stanno
+**     in un long long diventano bignum (node.big), nelle altre sono un
+**     errore BAD_TOO_LARGE. vbc_ctx_init la mette a MODE_INT
+**   - src: stringa in analisi (testo dei letterali grandi)
+**   - tokens: buffer dei token, riusato
+**   - tok: cursore sul token corrente
+**   - err: primo token inatteso (NULL se non ci sono errori)
+**   - diags/last: modalità con recupero di vbc_diagnose
+**   - alloc/release/alloc_arg: allocatore dei nodi; se NULL si usano
+**     new_node() e destroy_tree(). Gli alberi creati con un allocatore
+**     proprio vanno liberati con vbc_tree_free() sullo stesso contesto.
+*/
+typedef struct s_vbc_ctx {
+	t_mode		mode;
+	const char	*src;
+	t_tokens	tokens;
+	t_token		*tok;
+	t_token		*err;
+	t_token		*last;
+	t_diags		*diags;
+	void		*(*alloc)(void *arg, size_t size);
+	void		(*release)(void *arg, void *ptr);
+	void		*alloc_arg;
+}	t_vbc_ctx;
+
+void	vbc_ctx_init(t_vbc_ctx *ctx);
+void	vbc_ctx_destroy(t_vbc_ctx *ctx);
+node	*vbc_parse(t_vbc_ctx *ctx, const char *str, int *bad);
+int		vbc_diagnose(t_vbc_ctx *ctx, const char *str, t_diags *out);
+void	vbc_tree_free(t_vbc_ctx *ctx, node *tree);
+
+/*PARSER*/
+node	*ft_factor(t_vbc_ctx *ctx);
+node	*ft_product(t_vbc_ctx *ctx);
+node	*ft_sum(t_vbc_ctx *ctx);
+
+#endif
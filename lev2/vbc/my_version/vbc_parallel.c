@@ -0,0 +1,198 @@
+#include "vbc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+** Valutazione parallela di alberi molto grandi.
+**
+** Il parser produce catene sinistre: 1+2+3+4 diventa
+** ADD(ADD(ADD(1,2),3),4). Dividere sui figli l/r non dà parallelismo,
+** quindi la catena di nodi dello stesso tipo viene "appiattita" in un
+** array di operandi (ADD e MULTI sono associativi) e l'array viene
+** ridotto a blocchi:
+**   - sotto PAR_MIN_OPERANDS operandi si resta seriali, scendendo
+**     negli operandi per trovare catene larghe più in basso
+**   - sopra, i thread prendono blocchi con un indice atomico condiviso
+**     (chi finisce prima prende il blocco successivo) e ogni blocco
+**     produce un risultato parziale; i parziali si combinano in ordine
+*/
+#define PAR_MIN_OPERANDS 4096
+#define PAR_MAX_DEPTH 8
+
+typedef struct s_ops {
+	node	**v;
+	size_t	len;
+	size_t	cap;
+}	t_ops;
+
+typedef struct s_reduce {
+	t_ops			*ops;
+	int				type;
+	t_mode			mode;
+	size_t			chunk;
+	size_t			nchunks;
+	t_result		*partial;
+	atomic_size_t	next;
+}	t_reduce;
+
+static int	push_op(t_ops *ops, node *n)
+{
+	if (ops->len == ops->cap)
+	{
+		size_t	cap = ops->cap ? ops->cap * 2 : 64;
+		node	**tmp = realloc(ops->v, cap * sizeof(*tmp));
+		if (!tmp)
+			return (-1);
+		ops->v = tmp;
+		ops->cap = cap;
+	}
+	ops->v[ops->len++] = n;
+	return (0);
+}
+
+/*
+** Scende iterativamente lungo la spina sinistra finché il tipo resta
+** quello di n, raccogliendo i figli destri; poi inverte l'array per
+** avere gli operandi da sinistra a destra. Iterativo perché la catena
+** può essere lunga milioni di nodi.
+*/
+static int	flatten(node *n, t_ops *ops)
+{
+	int	type = n->type;
+
+	while ((int)n->type == type && n->type != VAL)
+	{
+		if (push_op(ops, n->r))
+			return (-1);
+		n = n->l;
+	}
+	if (push_op(ops, n))
+		return (-1);
+	for (size_t i = 0; i < ops->len / 2; i++)
+	{
+		node	*tmp = ops->v[i];
+		ops->v[i] = ops->v[ops->len - 1 - i];
+		ops->v[ops->len - 1 - i] = tmp;
+	}
+	return (0);
+}
+
+/*
+** acc = acc (op) x, poi libera x. In MODE_INT si lavora su unsigned
+** per avere l'overflow definito (stesso risultato a 32 bit di
+** eval_tree, indipendente dall'ordine delle operazioni).
+*/
+static void	combine(t_result *acc, t_result *x, int type)
+{
+	if (acc->err || x->err)
+		acc->err = acc->err ? acc->err : x->err;
+	else if (acc->mode == MODE_INT && type == ADD)
+		acc->i = (int)((unsigned)acc->i + (unsigned)x->i);
+	else if (acc->mode == MODE_INT)
+		acc->i = (int)((unsigned)acc->i * (unsigned)x->i);
+	else if (acc->mode == MODE_CHECKED && type == ADD)
+		acc->err = __builtin_add_overflow(acc->ll, x->ll, &acc->ll) ? RES_OVERFLOW : 0;
+	else if (acc->mode == MODE_CHECKED)
+		acc->err = __builtin_mul_overflow(acc->ll, x->ll, &acc->ll) ? RES_OVERFLOW : 0;
+	else if (type == ADD)
+		acc->err = big_add(&acc->big, &acc->big, &x->big) ? RES_NOMEM : 0;
+	else
+		acc->err = big_mul(&acc->big, &acc->big, &x->big) ? RES_NOMEM : 0;
+	big_free(&x->big);
+}
+
+static void	reduce_range(node **v, size_t n, int type, t_mode mode, t_result *res)
+{
+	t_result	x;
+
+	eval_result(v[0], mode, res);
+	for (size_t i = 1; i < n; i++)
+	{
+		eval_result(v[i], mode, &x);
+		combine(res, &x, type);
+	}
+}
+
+static void	*reduce_worker(void *arg)
+{
+	t_reduce	*r = arg;
+	size_t		c;
+
+	while ((c = atomic_fetch_add(&r->next, 1)) < r->nchunks)
+	{
+		size_t	from = c * r->chunk;
+		size_t	n = from + r->chunk < r->ops->len ? r->chunk : r->ops->len - from;
+
+		reduce_range(r->ops->v + from, n, r->type, r->mode, &r->partial[c]);
+	}
+	return (NULL);
+}
+
+/*
+** Riduce ops in parallelo su `threads` thread (il chiamante è uno di
+** essi). Ritorna -1 se fallisce un'allocazione prima di iniziare.
+*/
+static int	reduce_parallel(t_ops *ops, int type, t_mode mode, int threads,
+		t_result *res)
+{
+	t_reduce	r = {.ops = ops, .type = type, .mode = mode};
+	pthread_t	tid[threads];
+	int			started[threads];
+
+	r.chunk = ops->len / ((size_t)threads * 8);
+	if (r.chunk < 256)
+		r.chunk = 256;
+	r.nchunks = (ops->len + r.chunk - 1) / r.chunk;
+	r.partial = calloc(r.nchunks, sizeof(*r.partial));
+	if (!r.partial)
+		return (-1);
+	atomic_init(&r.next, 0);
+	for (int t = 1; t < threads; t++)
+		started[t] = pthread_create(&tid[t], NULL, reduce_worker, &r) == 0;
+	reduce_worker(&r);
+	for (int t = 1; t < threads; t++)
+		if (started[t])
+			pthread_join(tid[t], NULL);
+	*res = r.partial[0];
+	for (size_t c = 1; c < r.nchunks; c++)
+		combine(res, &r.partial[c], type);
+	free(r.partial);
+	return (0);
+}
+
+static void	eval_par(node *tree, t_mode mode, int threads, int depth,
+		t_result *res)
+{
+	t_ops		ops = {0};
+	t_result	x;
+	int			type = tree->type;
+
+	if (type == VAL || depth >= PAR_MAX_DEPTH)
+		return (eval_result(tree, mode, res));
+	if (flatten(tree, &ops))
+	{
+		free(ops.v);
+		*res = (t_result){.mode = mode, .err = RES_NOMEM};
+		return ;
+	}
+	if (threads > 1 && ops.len >= PAR_MIN_OPERANDS
+		&& reduce_parallel(&ops, type, mode, threads, res) == 0)
+		return (free(ops.v));
+	eval_par(ops.v[0], mode, threads, depth + 1, res);
+	for (size_t i = 1; i < ops.len; i++)
+	{
+		eval_par(ops.v[i], mode, threads, depth + 1, &x);
+		combine(res, &x, type);
+	}
+	free(ops.v);
+}
+
+/*
+** eval_parallel: come eval_result, ma distribuisce le catene larghe
+** di ADD/MULTI su `threads` thread. Con threads <= 1 resta seriale,
+** ma evita comunque la ricorsione lungo le catene lunghe.
+*/
+void	eval_parallel(node *tree, t_mode mode, int threads, t_result *res)
+{
+	eval_par(tree, mode, threads, 0, res);
+}
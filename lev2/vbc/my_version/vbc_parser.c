@@ -0,0 +1,214 @@
+#include "vbc_lib.h"
+
+void	vbc_ctx_init(t_vbc_ctx *ctx)
+{
+	*ctx = (t_vbc_ctx){0};
+}
+
+void	vbc_ctx_destroy(t_vbc_ctx *ctx)
+{
+	free(ctx->tokens.v);
+	*ctx = (t_vbc_ctx){0};
+}
+
+static node	*ctx_node(t_vbc_ctx *ctx, node n)
+{
+	node	*ret;
+
+	if (!ctx->alloc)
+		return (new_node(n));
+	ret = ctx->alloc(ctx->alloc_arg, sizeof(n));
+	if (ret)
+		*ret = n;
+	return (ret);
+}
+
+/*
+** Come destroy_tree (iterativa lungo il figlio sinistro), ma restituisce
+** i nodi all'allocatore del contesto.
+*/
+void	vbc_tree_free(t_vbc_ctx *ctx, node *tree)
+{
+	node	*next;
+
+	if (!ctx->release)
+		return (destroy_tree(tree));
+	while (tree)
+	{
+		next = NULL;
+		if (tree->type != VAL)
+		{
+			vbc_tree_free(ctx, tree->r);
+			next = tree->l;
+		}
+		else
+			big_free(&tree->big);
+		ctx->release(ctx->alloc_arg, tree);
+		tree = next;
+	}
+}
+
+/*
+** Segnala il token corrente come inatteso e ritorna NULL, che risale
+** fino a vbc_parse. In modalità con recupero registra anche la
+** diagnostica (una sola volta per token, e mai per un token che il
+** lexer ha già segnalato).
+*/
+static node	*syntax_error(t_vbc_ctx *ctx)
+{
+	if (!ctx->err)
+		ctx->err = ctx->tok;
+	if (ctx->diags && ctx->last != ctx->tok && !ctx->tok->reported)
+		diag_push(ctx->diags, ctx->tok->pos, (unsigned char)ctx->tok->c);
+	ctx->last = ctx->tok;
+	return (NULL);
+}
+
+/*
+** Crea un nodo binario ADD/MULTI. Se uno dei due figli è NULL
+** (errore più in basso) libera l'altro e propaga NULL.
+*/
+static node	*bin_node(t_vbc_ctx *ctx, int type, node *l, node *r)
+{
+	node	*ret;
+
+	if (!l || !r)
+		return (vbc_tree_free(ctx, l), vbc_tree_free(ctx, r), NULL);
+	ret = ctx_node(ctx, (node){.type = type, .l = l, .r = r});
+	if (!ret)
+		return (vbc_tree_free(ctx, l), vbc_tree_free(ctx, r), NULL);
+	return (ret);
+}
+
+node	*ft_product(t_vbc_ctx *ctx)
+{
+	node	*a = ft_factor(ctx);
+	while(a && ctx->tok->type == T_STAR)
+	{
+		ctx->tok++;
+		a = bin_node(ctx, MULTI, a, ft_factor(ctx));
+	}
+	return(a);
+}
+
+node	*ft_sum(t_vbc_ctx *ctx)
+{
+	node	*sum = ft_product(ctx);
+	while(sum && ctx->tok->type == T_PLUS)
+	{
+		ctx->tok++;
+		sum = bin_node(ctx, ADD, sum, ft_product(ctx));
+	}
+	return(sum);
+}
+
+/*
+** Foglia per il token numero corrente; un letterale grande (solo in
+** MODE_BIG) si converte dalle sue cifre nel testo. NULL se fallisce
+** un'allocazione.
+*/
+static node	*num_node(t_vbc_ctx *ctx)
+{
+	t_token	*tok = ctx->tok++;
+	node	*n = ctx_node(ctx, (node){.type = VAL, .val = tok->val});
+
+	if(n && tok->big && big_from_str(&n->big, ctx->src + tok->pos, tok->len))
+		return(vbc_tree_free(ctx, n), NULL);
+	return(n);
+}
+
+node	*ft_factor(t_vbc_ctx *ctx)
+{
+	node	*n;
+
+	if(ctx->tok->type == T_NUM)
+		return(num_node(ctx));
+	if(ctx->tok->type != T_LPAREN)
+	{
+		syntax_error(ctx);
+		return(ctx->diags ? ctx_node(ctx, (node){.type = VAL}) : NULL);
+	}
+	ctx->tok++;
+	n = ft_sum(ctx);
+	if(n && ctx->tok->type != T_RPAREN)
+	{
+		syntax_error(ctx);
+		return(ctx->diags ? n : (vbc_tree_free(ctx, n), NULL));
+	}
+	ctx->tok++;
+	return (n);
+}
+
+/*
+** vbc_parse: tokenize nel buffer del contesto, poi discesa ricorsiva
+** sui token.
+** Se l'input non è valido ritorna NULL con *bad = carattere da
+** segnalare (0 = fine dell'input) o BAD_TOO_LARGE (vedi report_bad);
+** se fallisce un'allocazione ritorna NULL con *bad = -1.
+*/
+node	*vbc_parse(t_vbc_ctx *ctx, const char *str, int *bad)
+{
+	node	*tree;
+
+	*bad = -1;
+	if(tokenize(str, &ctx->tokens, ctx->mode, bad, NULL))
+		return(NULL);
+	ctx->src = str;
+	ctx->tok = ctx->tokens.v;
+	ctx->err = NULL;
+	ctx->diags = NULL;
+	tree = ft_sum(ctx);
+	if(tree && ctx->tok->type != T_END)
+		tree = (vbc_tree_free(ctx, tree), syntax_error(ctx));
+	if(ctx->err)
+		*bad = (unsigned char)ctx->err->c;
+	return(tree);
+}
+
+static int	diag_cmp(const void *a, const void *b)
+{
+	const t_diag	*x = a;
+	const t_diag	*y = b;
+
+	return((x->pos > y->pos) - (x->pos < y->pos));
+}
+
+/*
+** vbc_diagnose: analizza str senza fermarsi al primo errore e senza
+** uscire dal processo, raccogliendo in out tutte le diagnostiche con
+** la loro posizione. Il recupero avviene ai confini di operatori e
+** parentesi:
+**   - un fattore mancante diventa un segnaposto 0 (non consuma token)
+**   - una ')' mancante viene data per presente
+**   - un token in eccesso al livello più alto (")" in più, "1 2")
+**     viene saltato, insieme all'operatore che lo segue, e l'analisi
+**     riprende da lì
+** Le diagnostiche (lessicali e sintattiche) sono ordinate per posizione.
+** Ritorna il numero di diagnostiche, -1 se fallisce un'allocazione.
+*/
+int	vbc_diagnose(t_vbc_ctx *ctx, const char *str, t_diags *out)
+{
+	int		op;
+
+	out->len = 0;
+	if(tokenize(str, &ctx->tokens, ctx->mode, NULL, out) < 0)
+		return(-1);
+	ctx->src = str;
+	ctx->tok = ctx->tokens.v;
+	ctx->err = NULL;
+	ctx->last = NULL;
+	ctx->diags = out;
+	vbc_tree_free(ctx, ft_sum(ctx));
+	while(ctx->tok->type != T_END)
+	{
+		syntax_error(ctx);
+		ctx->tok++;
+		op = ctx->tok->type == T_PLUS || ctx->tok->type == T_STAR;
+		ctx->tok += op;
+		if(op || ctx->tok->type != T_END)
+			vbc_tree_free(ctx, ft_sum(ctx));
+	}
+	ctx->diags = NULL;
+	qsort(out->v, out->len, sizeof(*out->v), diag_cmp);
+	return((int)out->len);
+}